@@ -5,8 +5,50 @@
 #include <limits>
 #include <cctype>
 #include <iomanip>
+#include <sstream>
 #include <algorithm>
 #include <ctime>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <cerrno>
+#include <cmath>
+#include <charconv>
+#include <string_view>
+#include <unordered_map>
+#include <map>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <queue>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define PAYROLL_HAVE_AVX2 1
+#endif
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <csignal>
+#include <unistd.h>
+#else
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <io.h>
+#include <process.h>
+#endif
 
 // Cross-platform console utilities
 void clearScreen() {
@@ -79,689 +121,8075 @@ std::string getValidatedInput(const std::string& prompt, int maxLength) {
     return input;
 }
 
-class Employee {
-public:
-    int code{};
-    std::string name;
-    std::string address;
-    std::string phone;
-    int dd{}, mm{}, yy{};
-    std::string designation;
-    char grade{};
-    char house_allowance{};
-    char travel_allowance{};
-    float loan{};
-    float basic_salary{};
+// Monetary amounts are held as whole cents. Sums and differences are exact;
+// a percentage of an amount rounds half up to the nearest cent.
+struct Money {
+    int64_t cents = 0;
 
-    void display() const;
-    void displayForList() const;
+    Money() = default;
+    constexpr explicit Money(int64_t cents) : cents(cents) {}
+
+    static Money fromDollars(int64_t dollars) { return Money(dollars * 100); }
+
+    Money percent(int pct) const { return Money((cents * pct + 50) / 100); }
+    int64_t wholeDollars() const { return (cents + (cents < 0 ? -50 : 50)) / 100; }
+
+    Money operator+(Money other) const { return Money(cents + other.cents); }
+    Money operator-(Money other) const { return Money(cents - other.cents); }
+    Money& operator+=(Money other) { cents += other.cents; return *this; }
+    Money& operator-=(Money other) { cents -= other.cents; return *this; }
+    Money operator*(int64_t factor) const { return Money(cents * factor); }
+    bool operator==(Money other) const { return cents == other.cents; }
+    bool operator!=(Money other) const { return cents != other.cents; }
+    bool operator<(Money other) const { return cents < other.cents; }
+    bool operator>(Money other) const { return cents > other.cents; }
 };
 
-// File operations
-const std::string FILE_NAME = "EMPLOYEE.DAT";
+// Upper bound on salary and loan amounts, as enforced at input
+const Money MAX_AMOUNT = Money::fromDollars(50000);
 
-std::vector<Employee> readAllRecords() {
-    std::vector<Employee> records;
-    std::ifstream file(FILE_NAME, std::ios::binary);
-    if (file.is_open()) {
-        Employee emp;
-        while (file.read(reinterpret_cast<char*>(&emp), sizeof(Employee))) {
-            records.push_back(emp);
-        }
-        file.close();
+// Writes "-1234.56" style text; returns the number of characters written.
+int formatMoney(char* buffer, size_t size, Money amount) {
+    int64_t whole = amount.cents / 100;
+    int64_t frac = amount.cents % 100;
+    const char* sign = "";
+    if (amount.cents < 0) {
+        sign = "-";
+        whole = -whole;
+        frac = -frac;
     }
-    return records;
+    return std::snprintf(buffer, size, "%s%lld.%02lld", sign,
+                         static_cast<long long>(whole), static_cast<long long>(frac));
 }
 
-void writeAllRecords(const std::vector<Employee>& records) {
-    std::ofstream file(FILE_NAME, std::ios::binary | std::ios::trunc);
-    if (file.is_open()) {
-        for (const auto& emp : records) {
-            file.write(reinterpret_cast<const char*>(&emp), sizeof(Employee));
-        }
-        file.close();
-    }
+void appendMoney(std::string& out, Money amount) {
+    char buffer[32];
+    int len = formatMoney(buffer, sizeof(buffer), amount);
+    out.append(buffer, static_cast<size_t>(len));
 }
 
-void Employee::display() const {
-    printSeparator();
-    std::cout << "Employee Code  : " << code << std::endl;
-    std::cout << "Name           : " << name << std::endl;
-    std::cout << "Address        : " << address << std::endl;
-    std::cout << "Phone          : " << phone << std::endl;
-    std::cout << "Joining Date   : " << dd << "/" << mm << "/" << yy << std::endl;
-    std::cout << "Designation    : " << designation << std::endl;
-    std::cout << "Grade          : " << grade << std::endl;
-    
-    if (grade != 'E') {
-        std::cout << "House Allowance: " << house_allowance << std::endl;
-        std::cout << "Travel Allow.  : " << travel_allowance << std::endl;
-        std::cout << "Basic Salary   : $" << std::fixed << std::setprecision(2) << basic_salary << std::endl;
+// Appends a field in double quotes, doubling any embedded quotes.
+void appendCsvField(std::string& out, std::string_view text) {
+    out += '"';
+    for (char c : text) {
+        if (c == '"') out += '"';
+        out += c;
     }
-    std::cout << "Loan Amount    : $" << std::fixed << std::setprecision(2) << loan << std::endl;
-    printSeparator();
+    out += '"';
 }
 
-void Employee::displayForList() const {
-    std::cout << std::left 
-              << std::setw(6) << code
-              << std::setw(20) << name.substr(0, 19)
-              << std::setw(12) << phone.substr(0, 11)
-              << std::setw(12) << (std::to_string(dd) + "/" + std::to_string(mm) + "/" + std::to_string(yy))
-              << std::setw(15) << designation.substr(0, 14)
-              << std::setw(6) << grade
-              << std::setw(10);
-    
-    if (grade != 'E') {
-        std::cout << "$" << std::fixed << std::setprecision(0) << basic_salary;
-    } else {
-        std::cout << "-";
-    }
-    std::cout << std::endl;
+std::ostream& operator<<(std::ostream& os, Money amount) {
+    char buffer[32];
+    formatMoney(buffer, sizeof(buffer), amount);
+    return os << buffer;
 }
 
-class PayrollSystem {
-private:
-    void editMenu();
-public:
-    void mainMenu();
-    void newEmployee();
-    void displayEmployee();
-    void listEmployees();
-    void salarySlip();
-    void deleteEmployee();
-    void modifyEmployee();
+// Instrumentation. Timed operations keep a call count, total and maximum
+// time; counters track bytes moved, records scanned and heap allocations.
+// Everything is a relaxed atomic, so recording costs a clock read and a few
+// uncontended adds, and worker threads can record without locking.
+enum Metric {
+    METRIC_STORAGE_READ,
+    METRIC_STORAGE_WRITE,
+    METRIC_JOURNAL,
+    METRIC_LOOKUP,
+    METRIC_QUERY,
+    METRIC_SALARY,
+    METRIC_RENDER,
+    METRIC_COUNT
 };
 
-void PayrollSystem::mainMenu() {
-    int choice;
-    
-    while (true) {
-        clearScreen();
-        printHeader("PAYROLL MANAGEMENT SYSTEM");
-        
-        std::cout << "\n\n";
-        std::cout << "        1. NEW EMPLOYEE\n";
-        std::cout << "        2. DISPLAY EMPLOYEE\n";
-        std::cout << "        3. LIST OF EMPLOYEES\n";
-        std::cout << "        4. SALARY SLIP\n";
-        std::cout << "        5. EDIT MENU\n";
-        std::cout << "        0. QUIT\n\n";
-        std::cout << "Enter your choice (0-5): ";
-        
-        std::cin >> choice;
-        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-        
-        switch (choice) {
-            case 0:
-                std::cout << "\nThank you for using Payroll Management System!\n";
-                return;
-            case 1:
-                newEmployee();
-                break;
-            case 2:
-                displayEmployee();
-                break;
-            case 3:
-                listEmployees();
-                break;
-            case 4:
-                salarySlip();
-                break;
-            case 5:
-                editMenu();
-                break;
-            default:
-                std::cout << "\nInvalid choice! Please enter 0-5.\n";
-                pauseScreen();
-                break;
-        }
-    }
-}
+const char* const METRIC_NAMES[METRIC_COUNT] = {
+    "storage read", "storage write", "journal", "lookup", "query", "salary", "render"};
 
-void PayrollSystem::editMenu() {
-    int choice;
-    
-    while (true) {
-        clearScreen();
-        printHeader("EDIT MENU");
-        
-        std::cout << "\n\n";
-        std::cout << "        1. DELETE RECORD\n";
-        std::cout << "        2. MODIFY RECORD\n";
-        std::cout << "        0. BACK TO MAIN MENU\n\n";
-        std::cout << "Enter your choice (0-2): ";
-        
-        std::cin >> choice;
-        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-        
-        switch (choice) {
-            case 0:
-                return;
-            case 1:
-                deleteEmployee();
-                break;
-            case 2:
-                modifyEmployee();
-                break;
-            default:
-                std::cout << "\nInvalid choice! Please enter 0-2.\n";
-                pauseScreen();
-                break;
-        }
+struct OperationStats {
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> nanos{0};
+    std::atomic<uint64_t> maxNanos{0};
+};
+
+struct Metrics {
+    OperationStats operations[METRIC_COUNT];
+    std::atomic<uint64_t> bytesRead{0};
+    std::atomic<uint64_t> bytesWritten{0};
+    std::atomic<uint64_t> bytesRendered{0};
+    std::atomic<uint64_t> recordsScanned{0};
+};
+
+// Constant-initialised, so they are usable before main() and from operator new
+Metrics metrics;
+std::atomic<uint64_t> allocationCount{0};
+std::atomic<uint64_t> allocatedBytes{0};
+
+const auto metricsStart = std::chrono::steady_clock::now();
+
+void recordTime(Metric metric, uint64_t nanos) {
+    OperationStats& stats = metrics.operations[metric];
+    stats.calls.fetch_add(1, std::memory_order_relaxed);
+    stats.nanos.fetch_add(nanos, std::memory_order_relaxed);
+    uint64_t seen = stats.maxNanos.load(std::memory_order_relaxed);
+    while (nanos > seen && !stats.maxNanos.compare_exchange_weak(seen, nanos, std::memory_order_relaxed)) {
     }
 }
 
-void PayrollSystem::newEmployee() {
-    clearScreen();
-    printHeader("ADD NEW EMPLOYEE");
-    
-    Employee newEmp;
-    std::vector<Employee> allEmployees = readAllRecords();
+void countBytesRead(uint64_t bytes) { metrics.bytesRead.fetch_add(bytes, std::memory_order_relaxed); }
+void countBytesWritten(uint64_t bytes) { metrics.bytesWritten.fetch_add(bytes, std::memory_order_relaxed); }
+void countRecordsScanned(uint64_t records) { metrics.recordsScanned.fetch_add(records, std::memory_order_relaxed); }
 
-    // Auto-generate employee code
-    int lastCode = 0;
-    if (!allEmployees.empty()) {
-        lastCode = allEmployees.back().code;
+// Times the enclosing scope
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Metric metric) : metric(metric), start(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() {
+        recordTime(metric, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               std::chrono::steady_clock::now() - start).count()));
     }
-    newEmp.code = lastCode + 1;
 
-    std::cout << "\nEmployee Code: " << newEmp.code << " (auto-generated)\n";
-    std::cout << "Enter '0' at any prompt to exit\n\n";
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
 
-    // Get employee details
-    newEmp.name = getValidatedInput("Employee Name", 25);
-    if (newEmp.name == "0") return;
+private:
+    Metric metric;
+    std::chrono::steady_clock::time_point start;
+};
 
-    newEmp.address = getValidatedInput("Address", 50);
-    if (newEmp.address == "0") return;
+void printMetrics(std::ostream& out) {
+    char line[160];
+    double uptime = std::chrono::duration<double>(std::chrono::steady_clock::now() - metricsStart).count();
+    std::snprintf(line, sizeof(line), "Uptime: %.3f s\n", uptime);
+    out << line;
+    std::snprintf(line, sizeof(line), "%-16s %12s %14s %12s %12s\n", "OPERATION", "CALLS", "TOTAL ms", "AVG us", "MAX us");
+    out << line;
+    for (int i = 0; i < METRIC_COUNT; i++) {
+        const OperationStats& stats = metrics.operations[i];
+        uint64_t calls = stats.calls.load(std::memory_order_relaxed);
+        uint64_t nanos = stats.nanos.load(std::memory_order_relaxed);
+        std::snprintf(line, sizeof(line), "%-16s %12llu %14.3f %12.3f %12.3f\n", METRIC_NAMES[i],
+                      static_cast<unsigned long long>(calls), nanos / 1e6, calls > 0 ? nanos / 1e3 / calls : 0.0,
+                      stats.maxNanos.load(std::memory_order_relaxed) / 1e3);
+        out << line;
+    }
+    const std::pair<const char*, uint64_t> counters[] = {
+        {"Bytes read", metrics.bytesRead.load(std::memory_order_relaxed)},
+        {"Bytes written", metrics.bytesWritten.load(std::memory_order_relaxed)},
+        {"Bytes rendered", metrics.bytesRendered.load(std::memory_order_relaxed)},
+        {"Records scanned", metrics.recordsScanned.load(std::memory_order_relaxed)},
+        {"Allocations", allocationCount.load(std::memory_order_relaxed)},
+        {"Bytes allocated", allocatedBytes.load(std::memory_order_relaxed)},
+    };
+    for (const auto& counter : counters) {
+        std::snprintf(line, sizeof(line), "%-16s %12llu\n", counter.first, static_cast<unsigned long long>(counter.second));
+        out << line;
+    }
+}
 
-    std::cout << "Phone Number (or press Enter for none): ";
-    std::getline(std::cin, newEmp.phone);
-    if (newEmp.phone == "0") return;
-    if (newEmp.phone.empty()) newEmp.phone = "-";
+// Heap allocations are counted by replacing the global allocation and
+// deallocation functions as a set: every form of operator new counts and
+// takes its block from malloc (or the aligned allocator), and every form of
+// operator delete hands it back the matching way.
+static void* countedAllocate(size_t size) noexcept {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
 
-    // Date input with validation
-    bool validDate = false;
-    do {
-        std::cout << "\nJoining Date:\n";
-        std::cout << "Day (1-31): ";
-        std::cin >> newEmp.dd;
-        std::cout << "Month (1-12): ";
-        std::cin >> newEmp.mm;
-        std::cout << "Year (1900-2100): ";
-        std::cin >> newEmp.yy;
-        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-        
-        if (std::cin.fail()) {
-            std::cin.clear();
-            std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-            std::cout << "Invalid input! Please enter numbers only.\n";
-            validDate = false;
-        } else {
-            validDate = isValidDate(newEmp.dd, newEmp.mm, newEmp.yy);
-            if (!validDate) {
-                std::cout << "Invalid date! Please re-enter.\n";
-            }
-        }
-    } while (!validDate);
+static void* countedAllocate(size_t size, std::align_val_t align) noexcept {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    size_t alignment = static_cast<size_t>(align);
+    size_t rounded = (std::max<size_t>(size, 1) + alignment - 1) / alignment * alignment;
+#ifdef _WIN32
+    return _aligned_malloc(rounded, alignment);
+#else
+    return std::aligned_alloc(alignment, rounded);
+#endif
+}
 
-    newEmp.designation = getValidatedInput("Designation", 20);
-    if (newEmp.designation == "0") return;
+// Kept out of line so the compiler does not pair the free() with the
+// operator new it was inlined beside and warn about a mismatch
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+static void release(void* block) noexcept {
+    std::free(block);
+}
 
-    // Grade input
-    do {
-        std::cout << "Grade (A/B/C/D/E): ";
-        std::cin >> newEmp.grade;
-        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-        newEmp.grade = toupper(newEmp.grade);
-        
-        if (newEmp.grade < 'A' || newEmp.grade > 'E') {
-            std::cout << "Invalid grade! Please enter A, B, C, D, or E.\n";
-        }
-    } while (newEmp.grade < 'A' || newEmp.grade > 'E');
+static void releaseAligned(void* block) noexcept {
+#ifdef _WIN32
+    _aligned_free(block);
+#else
+    release(block);
+#endif
+}
 
-    // Grade-specific inputs
-    if (newEmp.grade != 'E') {
-        do {
-            std::cout << "House Allowance (Y/N): ";
-            std::cin >> newEmp.house_allowance;
-            std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-            newEmp.house_allowance = toupper(newEmp.house_allowance);
-        } while (newEmp.house_allowance != 'Y' && newEmp.house_allowance != 'N');
+void* operator new(size_t size) {
+    if (void* block = countedAllocate(size)) return block;
+    throw std::bad_alloc();
+}
 
-        do {
-            std::cout << "Travel Allowance (Y/N): ";
-            std::cin >> newEmp.travel_allowance;
-            std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-            newEmp.travel_allowance = toupper(newEmp.travel_allowance);
-        } while (newEmp.travel_allowance != 'Y' && newEmp.travel_allowance != 'N');
+void* operator new[](size_t size) {
+    if (void* block = countedAllocate(size)) return block;
+    throw std::bad_alloc();
+}
 
-        do {
-            std::cout << "Basic Salary (max 50000): $";
-            std::cin >> newEmp.basic_salary;
-            if (std::cin.fail() || newEmp.basic_salary < 0 || newEmp.basic_salary > 50000) {
-                std::cin.clear();
-                std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-                std::cout << "Invalid salary! Please enter a value between 0 and 50000.\n";
-            } else {
-                std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-                break;
-            }
-        } while (true);
-    }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return countedAllocate(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return countedAllocate(size); }
 
-    do {
-        std::cout << "Loan Amount (max 50000): $";
-        std::cin >> newEmp.loan;
-        if (std::cin.fail() || newEmp.loan < 0 || newEmp.loan > 50000) {
-            std::cin.clear();
-            std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-            std::cout << "Invalid loan amount! Please enter a value between 0 and 50000.\n";
-        } else {
-            std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-            break;
-        }
-    } while (true);
+void* operator new(size_t size, std::align_val_t align) {
+    if (void* block = countedAllocate(size, align)) return block;
+    throw std::bad_alloc();
+}
 
-    // Confirm save
-    char saveChoice;
-    std::cout << "\nDo you want to save this record? (Y/N): ";
-    std::cin >> saveChoice;
-    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-    
-    if (toupper(saveChoice) == 'Y') {
-        allEmployees.push_back(newEmp);
-        writeAllRecords(allEmployees);
-        std::cout << "\nRecord added successfully!\n";
-    } else {
-        std::cout << "\nRecord not saved.\n";
-    }
-    
-    pauseScreen();
+void* operator new[](size_t size, std::align_val_t align) {
+    if (void* block = countedAllocate(size, align)) return block;
+    throw std::bad_alloc();
 }
 
-void PayrollSystem::displayEmployee() {
-    clearScreen();
-    printHeader("DISPLAY EMPLOYEE");
-    
-    int searchCode;
-    std::cout << "\nEnter Employee Code (0 to exit): ";
-    std::cin >> searchCode;
-    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+void* operator new(size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+    return countedAllocate(size, align);
+}
 
-    if (searchCode == 0) return;
+void* operator new[](size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+    return countedAllocate(size, align);
+}
 
-    std::vector<Employee> allEmployees = readAllRecords();
-    bool found = false;
-    
-    for (const auto& emp : allEmployees) {
-        if (emp.code == searchCode) {
-            std::cout << "\n";
-            emp.display();
-            found = true;
-            break;
-        }
-    }
+void operator delete(void* block) noexcept { release(block); }
+void operator delete[](void* block) noexcept { release(block); }
+void operator delete(void* block, size_t) noexcept { release(block); }
+void operator delete[](void* block, size_t) noexcept { release(block); }
+void operator delete(void* block, const std::nothrow_t&) noexcept { release(block); }
+void operator delete[](void* block, const std::nothrow_t&) noexcept { release(block); }
+void operator delete(void* block, std::align_val_t) noexcept { releaseAligned(block); }
+void operator delete[](void* block, std::align_val_t) noexcept { releaseAligned(block); }
+void operator delete(void* block, size_t, std::align_val_t) noexcept { releaseAligned(block); }
+void operator delete[](void* block, size_t, std::align_val_t) noexcept { releaseAligned(block); }
+void operator delete(void* block, std::align_val_t, const std::nothrow_t&) noexcept { releaseAligned(block); }
+void operator delete[](void* block, std::align_val_t, const std::nothrow_t&) noexcept { releaseAligned(block); }
 
-    if (!found) {
-        std::cout << "\nEmployee with code " << searchCode << " not found!\n";
+// Report rendering. Rows are formatted into one reusable buffer that is
+// handed to the stream when it fills or when the caller flushes (once per
+// page or screen), instead of flushing after every line.
+class ReportBuffer {
+public:
+    explicit ReportBuffer(std::ostream& out, size_t capacity = 1 << 16)
+        : out(out), capacity(capacity) {
+        buffer.reserve(capacity + 256);
+    }
+    ~ReportBuffer() { flush(); }
+
+    ReportBuffer(const ReportBuffer&) = delete;
+    ReportBuffer& operator=(const ReportBuffer&) = delete;
+
+    ReportBuffer& text(std::string_view value) {
+        buffer.append(value.data(), value.size());
+        return *this;
+    }
+
+    ReportBuffer& ch(char c, size_t count = 1) {
+        buffer.append(count, c);
+        return *this;
+    }
+
+    // Left-aligned in a field of the given width (never truncated)
+    ReportBuffer& left(std::string_view value, size_t width) {
+        text(value);
+        if (value.size() < width) buffer.append(width - value.size(), ' ');
+        return *this;
+    }
+
+    // Right-aligned in a field of the given width (never truncated)
+    ReportBuffer& right(std::string_view value, size_t width) {
+        if (value.size() < width) buffer.append(width - value.size(), ' ');
+        return text(value);
+    }
+
+    ReportBuffer& endLine() {
+        buffer += '\n';
+        if (buffer.size() >= capacity) flush();
+        return *this;
+    }
+
+    void flush() {
+        if (!buffer.empty()) {
+            metrics.bytesRendered.fetch_add(buffer.size(), std::memory_order_relaxed);
+            out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            buffer.clear();
+        }
+        out.flush();
+    }
+
+private:
+    std::ostream& out;
+    size_t capacity;
+    std::string buffer;
+};
+
+// Small formatted values kept on the stack, for use with ReportBuffer
+struct FormattedText {
+    char data[32];
+    size_t size = 0;
+
+    operator std::string_view() const { return std::string_view(data, size); }
+};
+
+FormattedText toText(int64_t value) {
+    FormattedText result;
+    result.size = static_cast<size_t>(std::to_chars(result.data, result.data + sizeof(result.data), value).ptr - result.data);
+    return result;
+}
+
+FormattedText toText(Money amount) {
+    FormattedText result;
+    result.size = static_cast<size_t>(formatMoney(result.data, sizeof(result.data), amount));
+    return result;
+}
+
+// "d/m/yyyy", as shown on every screen
+FormattedText dateText(int d, int m, int y) {
+    FormattedText result;
+    char* end = result.data + sizeof(result.data);
+    char* pos = std::to_chars(result.data, end, d).ptr;
+    *pos++ = '/';
+    pos = std::to_chars(pos, end, m).ptr;
+    *pos++ = '/';
+    pos = std::to_chars(pos, end, y).ptr;
+    result.size = static_cast<size_t>(pos - result.data);
+    return result;
+}
+
+// Parses "1234", "1234.5" or "1234.56" (optionally prefixed with '$') exactly.
+bool parseMoney(const std::string& text, Money& out) {
+    size_t i = 0;
+    while (i < text.size() && isspace(static_cast<unsigned char>(text[i]))) i++;
+    if (i < text.size() && text[i] == '$') i++;
+
+    int64_t whole = 0;
+    int digits = 0;
+    while (i < text.size() && isdigit(static_cast<unsigned char>(text[i]))) {
+        whole = whole * 10 + (text[i] - '0');
+        if (++digits > 12) return false;
+        i++;
+    }
+
+    int64_t frac = 0;
+    int fracDigits = 0;
+    if (i < text.size() && text[i] == '.') {
+        i++;
+        while (i < text.size() && isdigit(static_cast<unsigned char>(text[i]))) {
+            if (++fracDigits > 2) return false;
+            frac = frac * 10 + (text[i] - '0');
+            i++;
+        }
+    }
+    while (i < text.size() && isspace(static_cast<unsigned char>(text[i]))) i++;
+    if (i != text.size() || (digits == 0 && fracDigits == 0)) return false;
+
+    if (fracDigits == 1) frac *= 10;
+    out = Money(whole * 100 + frac);
+    return true;
+}
+
+bool isValidAmount(Money amount) {
+    return !(amount < Money(0)) && !(amount > MAX_AMOUNT);
+}
+
+// Grades A-D are paid a monthly salary, grade E by the day and hour
+enum PayBasis {
+    PAY_SALARIED,
+    PAY_DAILY
+};
+
+constexpr PayBasis gradeBasis(int grade) {
+    return grade == 'E' - 'A' ? PAY_DAILY : PAY_SALARIED;
+}
+
+// Rule of a grade letter; a damaged grade is paid as grade A
+constexpr int gradeIndex(char grade) {
+    return grade >= 'A' && grade <= 'E' ? grade - 'A' : 0;
+}
+
+// True for a grade paid from the timesheet, with no basic salary or
+// allowances
+constexpr bool isDailyGrade(char grade) {
+    return gradeBasis(gradeIndex(grade)) == PAY_DAILY;
+}
+
+class Employee {
+public:
+    int code{};
+    std::string name;
+    std::string address;
+    std::string phone;
+    int dd{}, mm{}, yy{};
+    std::string designation;
+    char grade{};
+    char house_allowance{};
+    char travel_allowance{};
+    Money loan;
+    Money basic_salary;
+
+    void display() const;
+    void display(ReportBuffer& out) const;
+};
+
+// File operations
+const std::string FILE_NAME = "EMPLOYEE.DAT";
+
+// On-disk layout of EMPLOYEE.DAT: one FileHeader followed by record_count
+// fixed-width EmployeeRecord slots. Text fields are fixed-width char arrays,
+// NUL-padded and not necessarily NUL-terminated when the field is full.
+const char FILE_MAGIC[4] = {'P', 'A', 'Y', 'R'};
+const uint32_t FILE_VERSION = 2;
+
+const int NAME_WIDTH = 25;
+const int ADDRESS_WIDTH = 50;
+const int PHONE_WIDTH = 20;
+const int DESIGNATION_WIDTH = 20;
+
+#pragma pack(push, 1)
+struct FileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t record_count;
+    uint32_t checksum;      // Sum of recordChecksum() over all slots
+    uint32_t deleted_count; // Tombstoned slots awaiting compaction
+    int32_t last_code;      // Highest employee code ever assigned
+    uint8_t reserved[4];
+};
+
+struct EmployeeRecord {
+    int32_t code;
+    char name[NAME_WIDTH];
+    char address[ADDRESS_WIDTH];
+    char phone[PHONE_WIDTH];
+    char designation[DESIGNATION_WIDTH];
+    uint8_t dd;
+    uint8_t mm;
+    uint16_t yy;
+    char grade;
+    char house_allowance;
+    char travel_allowance;
+    uint8_t flags;          // RECORD_* bits
+    int32_t loan;           // Cents
+    int32_t basic_salary;   // Cents
+};
+#pragma pack(pop)
+
+const uint8_t RECORD_DELETED = 0x01;
+
+static_assert(sizeof(FileHeader) == 32, "FileHeader layout changed");
+static_assert(sizeof(EmployeeRecord) == 135, "EmployeeRecord layout changed");
+
+// FNV-1a over one record. The file checksum is the wrapping sum of these, so a
+// single slot can be re-checksummed without touching the rest of the file.
+uint32_t fnv1a(const void* data, size_t size, uint32_t hash = 2166136261u) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+uint32_t recordChecksum(const EmployeeRecord& rec) {
+    return fnv1a(&rec, sizeof(EmployeeRecord));
+}
+
+void copyField(char* dest, size_t width, const std::string& src) {
+    std::memset(dest, 0, width);
+    std::memcpy(dest, src.data(), std::min(width, src.size()));
+}
+
+// Length of a fixed-width text field, without building a std::string
+size_t fieldLength(const char* src, size_t width) {
+    size_t len = 0;
+    while (len < width && src[len] != '\0') len++;
+    return len;
+}
+
+std::string_view fieldView(const char* src, size_t width) {
+    return std::string_view(src, fieldLength(src, width));
+}
+
+std::string readField(const char* src, size_t width) {
+    return std::string(src, fieldLength(src, width));
+}
+
+EmployeeRecord toRecord(const Employee& emp) {
+    EmployeeRecord rec;
+    std::memset(&rec, 0, sizeof(rec));
+    rec.code = emp.code;
+    copyField(rec.name, NAME_WIDTH, emp.name);
+    copyField(rec.address, ADDRESS_WIDTH, emp.address);
+    copyField(rec.phone, PHONE_WIDTH, emp.phone);
+    copyField(rec.designation, DESIGNATION_WIDTH, emp.designation);
+    rec.dd = static_cast<uint8_t>(emp.dd);
+    rec.mm = static_cast<uint8_t>(emp.mm);
+    rec.yy = static_cast<uint16_t>(emp.yy);
+    rec.grade = emp.grade;
+    rec.house_allowance = emp.house_allowance;
+    rec.travel_allowance = emp.travel_allowance;
+    rec.loan = static_cast<int32_t>(emp.loan.cents);
+    rec.basic_salary = static_cast<int32_t>(emp.basic_salary.cents);
+    return rec;
+}
+
+Employee fromRecord(const EmployeeRecord& rec) {
+    Employee emp;
+    emp.code = rec.code;
+    emp.name = readField(rec.name, NAME_WIDTH);
+    emp.address = readField(rec.address, ADDRESS_WIDTH);
+    emp.phone = readField(rec.phone, PHONE_WIDTH);
+    emp.designation = readField(rec.designation, DESIGNATION_WIDTH);
+    emp.dd = rec.dd;
+    emp.mm = rec.mm;
+    emp.yy = rec.yy;
+    emp.grade = rec.grade;
+    emp.house_allowance = rec.house_allowance;
+    emp.travel_allowance = rec.travel_allowance;
+    emp.loan = Money(rec.loan);
+    emp.basic_salary = Money(rec.basic_salary);
+    return emp;
+}
+
+// Arena for the text of loaded records. Strings are copied into large
+// blocks, each twice the size of the one before, and handed out as views,
+// so loading a roster costs a few big allocations rather than several per
+// record. Blocks never move, so views stay valid while the pool lives, even
+// if the pool itself is moved.
+class StringPool {
+public:
+    std::string_view store(std::string_view text);
+
+private:
+    std::vector<std::unique_ptr<char[]>> blocks;
+    size_t used = 0;
+    size_t capacity = 0;
+};
+
+std::string_view StringPool::store(std::string_view text) {
+    if (text.empty()) {
+        return std::string_view();
+    }
+    if (capacity - used < text.size()) {
+        capacity = std::max(std::max<size_t>(capacity * 2, 1 << 16), text.size());
+        capacity = std::min<size_t>(capacity, std::max<size_t>(64 << 20, text.size()));
+        blocks.push_back(std::make_unique<char[]>(capacity));
+        used = 0;
+    }
+    char* dest = blocks.back().get() + used;
+    std::memcpy(dest, text.data(), text.size());
+    used += text.size();
+    return std::string_view(dest, text.size());
+}
+
+// One loaded employee. Text fields point into the table's pool; the
+// designation is an ID from the table's dictionary, so comparing or
+// grouping by designation compares integers.
+struct EmployeeRow {
+    int32_t code;
+    std::string_view name;
+    std::string_view address;
+    std::string_view phone;
+    uint32_t designation;
+    uint16_t yy;
+    uint8_t dd, mm;
+    char grade;
+    char house_allowance;
+    char travel_allowance;
+    Money loan;
+    Money basic_salary;
+};
+
+// A roster loaded into memory: fixed-size rows plus one string pool, with
+// every distinct designation stored once. ID 0 is the empty designation.
+class EmployeeTable {
+public:
+    EmployeeTable() { internDesignation(std::string_view()); }
+
+    void reserve(size_t count) { rows.reserve(count); }
+    void add(const EmployeeRecord& rec);
+
+    size_t size() const { return rows.size(); }
+    const EmployeeRow& operator[](size_t i) const { return rows[i]; }
+    std::vector<EmployeeRow>::const_iterator begin() const { return rows.begin(); }
+    std::vector<EmployeeRow>::const_iterator end() const { return rows.end(); }
+
+private:
+    StringPool pool;
+    std::vector<EmployeeRow> rows;
+    std::unordered_map<std::string_view, uint32_t> designationIds;
+
+    uint32_t internDesignation(std::string_view name);
+};
+
+uint32_t EmployeeTable::internDesignation(std::string_view name) {
+    auto found = designationIds.find(name);
+    if (found != designationIds.end()) {
+        return found->second;
+    }
+    uint32_t id = static_cast<uint32_t>(designationIds.size());
+    designationIds.emplace(pool.store(name), id);
+    return id;
+}
+
+void EmployeeTable::add(const EmployeeRecord& rec) {
+    EmployeeRow row;
+    row.code = rec.code;
+    row.name = pool.store(fieldView(rec.name, NAME_WIDTH));
+    row.address = pool.store(fieldView(rec.address, ADDRESS_WIDTH));
+    row.phone = pool.store(fieldView(rec.phone, PHONE_WIDTH));
+    row.designation = internDesignation(fieldView(rec.designation, DESIGNATION_WIDTH));
+    row.yy = rec.yy;
+    row.dd = rec.dd;
+    row.mm = rec.mm;
+    row.grade = rec.grade;
+    row.house_allowance = rec.house_allowance;
+    row.travel_allowance = rec.travel_allowance;
+    row.loan = Money(rec.loan);
+    row.basic_salary = Money(rec.basic_salary);
+    rows.push_back(row);
+}
+
+std::streamoff recordOffset(uint32_t slot) {
+    return static_cast<std::streamoff>(sizeof(FileHeader)) +
+           static_cast<std::streamoff>(slot) * sizeof(EmployeeRecord);
+}
+
+bool isSupportedHeader(const FileHeader& header) {
+    return std::memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) == 0 &&
+           header.version == FILE_VERSION &&
+           header.record_size == sizeof(EmployeeRecord);
+}
+
+// Reads and validates the header. Returns false for a missing, foreign or
+// unsupported file; a short file has its record count clamped to what exists.
+// Bytes from the read position to the end of the file. A count read from a
+// file is checked against this before anything is allocated for it, so a
+// damaged header cannot ask for more memory than the file could fill.
+uint64_t bytesRemaining(std::istream& file) {
+    std::streampos here = file.tellg();
+    if (here < 0 || !file.seekg(0, std::ios::end)) {
+        file.clear();
+        return 0;
+    }
+    std::streampos end = file.tellg();
+    file.seekg(here);
+    return end > here ? static_cast<uint64_t>(end - here) : 0;
+}
+
+bool readHeader(std::istream& file, FileHeader& header, const std::string& fileName) {
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(FileHeader))) {
+        return false;
+    }
+    if (!isSupportedHeader(header)) {
+        std::cerr << "Warning: " << fileName << " is not in a supported format and was ignored.\n";
+        return false;
+    }
+
+    file.seekg(0, std::ios::end);
+    std::streamoff available = static_cast<std::streamoff>(file.tellg()) - sizeof(FileHeader);
+    uint32_t present = static_cast<uint32_t>(available / sizeof(EmployeeRecord));
+    if (present < header.record_count) {
+        std::cerr << "Warning: " << fileName << " is truncated; " << present
+                  << " of " << header.record_count << " records recovered.\n";
+        header.record_count = present;
+    }
+    file.seekg(sizeof(FileHeader), std::ios::beg);
+    return true;
+}
+
+// Version 1 files stored salary and loan as float dollars in the same slot
+// layout. They are converted to integer cents in a single rewrite.
+const uint32_t FLOAT_AMOUNTS_VERSION = 1;
+
+int32_t floatDollarsToCents(int32_t bits) {
+    float dollars;
+    std::memcpy(&dollars, &bits, sizeof(dollars));
+    if (!(dollars > 0.0f)) return 0;
+    return static_cast<int32_t>(std::llround(std::min<double>(dollars, 21474836.0) * 100.0));
+}
+
+bool upgradeDataFile(const std::string& fileName) {
+    std::ifstream in(fileName, std::ios::binary);
+    FileHeader header;
+    if (!in.is_open() || !in.read(reinterpret_cast<char*>(&header), sizeof(FileHeader)) ||
+        std::memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 ||
+        header.version != FLOAT_AMOUNTS_VERSION ||
+        header.record_size != sizeof(EmployeeRecord)) {
+        return false;
+    }
+
+    std::vector<EmployeeRecord> slots(header.record_count);
+    in.read(reinterpret_cast<char*>(slots.data()), slots.size() * sizeof(EmployeeRecord));
+    slots.resize(static_cast<size_t>(in.gcount()) / sizeof(EmployeeRecord));
+    in.close();
+
+    header.version = FILE_VERSION;
+    header.record_count = static_cast<uint32_t>(slots.size());
+    header.checksum = 0;
+    for (auto& rec : slots) {
+        rec.basic_salary = floatDollarsToCents(rec.basic_salary);
+        rec.loan = floatDollarsToCents(rec.loan);
+        header.checksum += recordChecksum(rec);
+    }
+
+    const std::string tempName = fileName + ".tmp";
+    std::ofstream out(tempName, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
+    out.write(reinterpret_cast<const char*>(slots.data()), slots.size() * sizeof(EmployeeRecord));
+    out.close();
+    if (!out || std::rename(tempName.c_str(), fileName.c_str()) != 0) {
+        std::remove(tempName.c_str());
+        return false;
+    }
+    std::cerr << "Note: " << fileName << " was upgraded to integer-cent amounts.\n";
+    return true;
+}
+
+FileHeader makeHeader() {
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+    header.version = FILE_VERSION;
+    header.record_size = sizeof(EmployeeRecord);
+    return header;
+}
+
+// Read-only, zero-copy view of a data file. On POSIX systems the file is
+// mmap'ed and records are used in place; elsewhere it is read into one buffer.
+// The checksum is not verified here, so opening costs the same for any size.
+class MappedRoster {
+public:
+    explicit MappedRoster(const std::string& fileName);
+    // View over slots already in memory; they are not copied and must
+    // outlive the view
+    MappedRoster(const EmployeeRecord* records, uint32_t count, const FileHeader& header)
+        : records(records), count(count), header(header) {}
+    ~MappedRoster();
+
+    MappedRoster(const MappedRoster&) = delete;
+    MappedRoster& operator=(const MappedRoster&) = delete;
+
+    bool isOpen() const { return records != nullptr; }
+    uint32_t size() const { return count; }
+    uint32_t liveCount() const { return count - std::min(count, header.deleted_count); }
+    const FileHeader& fileHeader() const { return header; }
+
+    const EmployeeRecord& operator[](uint32_t slot) const { return records[slot]; }
+    const EmployeeRecord* begin() const { return records; }
+    const EmployeeRecord* end() const { return records + count; }
+
+private:
+    const EmployeeRecord* records = nullptr;
+    uint32_t count = 0;
+    FileHeader header{};
+#ifdef _WIN32
+    std::vector<char> buffer;
+#else
+    void* mapping = nullptr;
+    size_t length = 0;
+#endif
+};
+
+MappedRoster::MappedRoster(const std::string& fileName) {
+    size_t fileSize = 0;
+    const char* base = nullptr;
+
+#ifdef _WIN32
+    std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return;
+    }
+    fileSize = static_cast<size_t>(file.tellg());
+    buffer.resize(fileSize);
+    file.seekg(0, std::ios::beg);
+    file.read(buffer.data(), fileSize);
+    base = buffer.data();
+#else
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size >= static_cast<off_t>(sizeof(FileHeader))) {
+        length = static_cast<size_t>(info.st_size);
+        mapping = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapping == MAP_FAILED) {
+            mapping = nullptr;
+            length = 0;
+        } else {
+            madvise(mapping, length, MADV_SEQUENTIAL);
+            fileSize = length;
+            base = static_cast<const char*>(mapping);
+        }
+    }
+    close(fd);
+#endif
+
+    if (base == nullptr || fileSize < sizeof(FileHeader)) {
+        return;
+    }
+    std::memcpy(&header, base, sizeof(FileHeader));
+    if (!isSupportedHeader(header)) {
+        std::cerr << "Warning: " << fileName << " is not in a supported format and was ignored.\n";
+        header = FileHeader{};
+        return;
+    }
+
+    uint32_t present = static_cast<uint32_t>((fileSize - sizeof(FileHeader)) / sizeof(EmployeeRecord));
+    count = std::min(header.record_count, present);
+    records = reinterpret_cast<const EmployeeRecord*>(base + sizeof(FileHeader));
+}
+
+MappedRoster::~MappedRoster() {
+#ifndef _WIN32
+    if (mapping != nullptr) {
+        munmap(mapping, length);
+    }
+#endif
+}
+
+// Temporary file name private to this process, for writing a file beside
+// the one it will replace
+std::string processTempName(const std::string& fileName) {
+#ifdef _WIN32
+    return fileName + "." + std::to_string(_getpid()) + ".tmp";
+#else
+    return fileName + "." + std::to_string(getpid()) + ".tmp";
+#endif
+}
+
+// Renames a fully written temporary file over fileName, or discards it
+bool replaceFile(const std::string& tempName, const std::string& fileName, bool written) {
+    if (written && std::rename(tempName.c_str(), fileName.c_str()) == 0) {
+        return true;
+    }
+    std::remove(tempName.c_str());
+    return false;
+}
+
+// Code index (EMPLOYEE.IDX): an IndexHeader followed by entry_count IndexEntry
+// pairs sorted by code. A deleted employee keeps its entry with slot -1 until
+// the next compaction. The header records the data file's record count and
+// checksum as of the last sync; if they no longer match, the index is stale
+// and gets rebuilt from the data file.
+const std::string INDEX_FILE_NAME = "EMPLOYEE.IDX";
+const char INDEX_MAGIC[4] = {'P', 'I', 'D', 'X'};
+const uint32_t INDEX_VERSION = 1;
+
+#pragma pack(push, 1)
+struct IndexHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t data_record_count;
+    uint32_t data_checksum;
+    uint32_t reserved;
+};
+
+struct IndexEntry {
+    int32_t code;
+    int32_t slot;
+};
+#pragma pack(pop)
+
+class CodeIndex {
+public:
+    explicit CodeIndex(const std::string& fileName) : fileName(fileName) {}
+
+    bool load(const FileHeader& data);
+    bool save(const FileHeader& data);
+    void rebuild(const std::vector<EmployeeRecord>& slots);
+
+    long find(int code) const;
+    std::vector<int> liveCodes() const;
+    bool add(const std::vector<IndexEntry>& added, const FileHeader& data);
+    bool remove(int code, const FileHeader& data);
+    bool sync(const FileHeader& data);
+
+private:
+    std::string fileName;
+    std::vector<IndexEntry> entries;
+
+    IndexHeader makeIndexHeader(const FileHeader& data) const;
+    std::vector<IndexEntry>::iterator locate(int code);
+};
+
+IndexHeader CodeIndex::makeIndexHeader(const FileHeader& data) const {
+    IndexHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header.version = INDEX_VERSION;
+    header.entry_count = static_cast<uint32_t>(entries.size());
+    header.data_record_count = data.record_count;
+    header.data_checksum = data.checksum;
+    return header;
+}
+
+std::vector<IndexEntry>::iterator CodeIndex::locate(int code) {
+    return std::lower_bound(entries.begin(), entries.end(), code,
+                            [](const IndexEntry& entry, int value) {
+                                return entry.code < value;
+                            });
+}
+
+bool CodeIndex::load(const FileHeader& data) {
+    entries.clear();
+    std::ifstream file(fileName, std::ios::binary);
+    IndexHeader header;
+    if (!file.is_open() || !file.read(reinterpret_cast<char*>(&header), sizeof(IndexHeader))) {
+        return false;
+    }
+    if (std::memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 ||
+        header.version != INDEX_VERSION ||
+        header.data_record_count != data.record_count ||
+        header.data_checksum != data.checksum) {
+        return false;
+    }
+
+    if (static_cast<uint64_t>(header.entry_count) * sizeof(IndexEntry) > bytesRemaining(file)) {
+        return false;
+    }
+    entries.resize(header.entry_count);
+    if (!file.read(reinterpret_cast<char*>(entries.data()), entries.size() * sizeof(IndexEntry))) {
+        entries.clear();
+        return false;
+    }
+    return true;
+}
+
+// Writes the whole index beside the old one and renames it into place, so
+// another process reading the index never sees it half written
+bool CodeIndex::save(const FileHeader& data) {
+    IndexHeader header = makeIndexHeader(data);
+    const std::string tempName = processTempName(fileName);
+    std::ofstream file(tempName, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(IndexHeader));
+    file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(IndexEntry));
+    file.close();
+    return replaceFile(tempName, fileName, static_cast<bool>(file));
+}
+
+void CodeIndex::rebuild(const std::vector<EmployeeRecord>& slots) {
+    entries.clear();
+    entries.reserve(slots.size());
+    for (size_t i = 0; i < slots.size(); i++) {
+        if (!(slots[i].flags & RECORD_DELETED)) {
+            entries.push_back({slots[i].code, static_cast<int32_t>(i)});
+        }
+    }
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const IndexEntry& a, const IndexEntry& b) {
+                         return a.code < b.code;
+                     });
+}
+
+long CodeIndex::find(int code) const {
+    auto it = std::lower_bound(entries.begin(), entries.end(), code,
+                               [](const IndexEntry& entry, int value) {
+                                   return entry.code < value;
+                               });
+    if (it == entries.end() || it->code != code) {
+        return -1;
+    }
+    return it->slot;
+}
+
+// Every employee's code in ascending order
+std::vector<int> CodeIndex::liveCodes() const {
+    std::vector<int> codes;
+    codes.reserve(entries.size());
+    for (const auto& entry : entries) {
+        if (entry.slot >= 0) codes.push_back(entry.code);
+    }
+    return codes;
+}
+
+// Rewrites only the header, recording that the index matches the data file.
+bool CodeIndex::sync(const FileHeader& data) {
+    std::fstream file(fileName, std::ios::binary | std::ios::in | std::ios::out);
+    if (!file.is_open()) {
+        return save(data);
+    }
+    IndexHeader header = makeIndexHeader(data);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(IndexHeader));
+    return static_cast<bool>(file);
+}
+
+// Codes are issued in increasing order, so new entries normally land at the
+// end of the file as one block; anything else falls back to rewriting the index.
+bool CodeIndex::add(const std::vector<IndexEntry>& added, const FileHeader& data) {
+    bool appendable = true;
+    int32_t previous = entries.empty() ? std::numeric_limits<int32_t>::min() : entries.back().code;
+    for (const auto& entry : added) {
+        if (entry.code <= previous) {
+            appendable = false;
+            break;
+        }
+        previous = entry.code;
+    }
+
+    if (!appendable) {
+        for (const auto& entry : added) {
+            auto it = locate(entry.code);
+            if (it != entries.end() && it->code == entry.code) {
+                it->slot = entry.slot;
+            } else {
+                entries.insert(it, entry);
+            }
+        }
+        return save(data);
+    }
+
+    size_t firstNew = entries.size();
+    entries.insert(entries.end(), added.begin(), added.end());
+    std::fstream file(fileName, std::ios::binary | std::ios::in | std::ios::out);
+    if (!file.is_open()) {
+        return save(data);
+    }
+    file.seekp(sizeof(IndexHeader) + firstNew * sizeof(IndexEntry), std::ios::beg);
+    file.write(reinterpret_cast<const char*>(&entries[firstNew]), added.size() * sizeof(IndexEntry));
+    file.flush();
+    return static_cast<bool>(file) && sync(data);
+}
+
+bool CodeIndex::remove(int code, const FileHeader& data) {
+    auto it = locate(code);
+    if (it == entries.end() || it->code != code) {
+        return sync(data);
+    }
+    it->slot = -1;
+
+    std::fstream file(fileName, std::ios::binary | std::ios::in | std::ios::out);
+    if (!file.is_open()) {
+        return save(data);
+    }
+    file.seekp(sizeof(IndexHeader) + (it - entries.begin()) * sizeof(IndexEntry), std::ios::beg);
+    file.write(reinterpret_cast<const char*>(&*it), sizeof(IndexEntry));
+    file.flush();
+    return static_cast<bool>(file) && sync(data);
+}
+
+// Attribute index (EMPLOYEE.ATX): employee codes keyed by grade, designation,
+// name and joining date, so filtered queries do not read the roster. The file
+// holds a sorted snapshot of each key list followed by a log of later
+// changes; edits only append to the log, and the snapshot is rewritten when
+// the log has grown. Keys refer to codes rather than slots, so the index stays
+// valid across compaction. As with the code index, a header that does not
+// match the data file means the index is stale and is rebuilt on next use.
+const std::string ATTRIBUTE_INDEX_FILE_NAME = "EMPLOYEE.ATX";
+const char ATTRIBUTE_MAGIC[4] = {'P', 'A', 'T', 'X'};
+const uint32_t ATTRIBUTE_VERSION = 1;
+
+enum Attribute : uint8_t {
+    ATTRIBUTE_GRADE,
+    ATTRIBUTE_DESIGNATION,
+    ATTRIBUTE_NAME,
+    ATTRIBUTE_JOINED,
+    ATTRIBUTE_COUNT
+};
+
+// Joining dates are keyed as "yyyymmdd" text, which sorts chronologically
+const size_t JOINED_WIDTH = 8;
+
+#pragma pack(push, 1)
+struct AttributeHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t data_record_count;
+    uint32_t data_checksum;
+    uint32_t snapshot_count[ATTRIBUTE_COUNT];
+    uint32_t log_count;
+    uint32_t reserved;
+};
+
+// Fixed-width key, NUL-padded, so keys compare with memcmp and a shorter
+// key sorts before any longer key it is a prefix of
+template <size_t Width>
+struct KeyEntry {
+    char key[Width];
+    int32_t code;
+};
+
+// One log record: a key added to or removed from one attribute
+struct AttributeChange {
+    uint8_t attribute;
+    uint8_t removed;
+    char key[NAME_WIDTH];
+    int32_t code;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(AttributeHeader) == 40, "AttributeHeader layout changed");
+
+// Sorted (key, code) list for one attribute
+template <size_t Width>
+class KeyList {
+public:
+    typedef KeyEntry<Width> Entry;
+    std::vector<Entry> entries;
+
+    static bool before(const Entry& a, const Entry& b) {
+        int order = std::memcmp(a.key, b.key, Width);
+        return order < 0 || (order == 0 && a.code < b.code);
+    }
+
+    static Entry makeEntry(const char* key, int code) {
+        Entry entry;
+        std::memcpy(entry.key, key, Width);
+        entry.code = code;
+        return entry;
+    }
+
+    // Merges a batch of new entries in one pass instead of one insert each
+    void add(std::vector<Entry>& added) {
+        if (added.empty()) return;
+        std::sort(added.begin(), added.end(), before);
+        size_t middle = entries.size();
+        entries.insert(entries.end(), added.begin(), added.end());
+        std::inplace_merge(entries.begin(), entries.begin() + middle, entries.end(), before);
+        added.clear();
+    }
+
+    void remove(const Entry& entry) {
+        auto it = std::lower_bound(entries.begin(), entries.end(), entry, before);
+        if (it != entries.end() && !before(entry, *it)) {
+            entries.erase(it);
+        }
+    }
+
+    // Appends the codes whose first length key bytes lie between low and high
+    // inclusive: an exact match, a prefix match or a range, depending on length.
+    void collect(const char* low, const char* high, size_t length, std::vector<int>& codes) const {
+        length = std::min(length, Width);
+        auto it = std::lower_bound(entries.begin(), entries.end(), low,
+                                   [length](const Entry& entry, const char* value) {
+                                       return std::memcmp(entry.key, value, length) < 0;
+                                   });
+        for (; it != entries.end() && std::memcmp(it->key, high, length) <= 0; ++it) {
+            codes.push_back(it->code);
+        }
+    }
+};
+
+class AttributeIndex {
+public:
+    explicit AttributeIndex(const std::string& fileName) : fileName(fileName) {}
+
+    // True if the lists in memory reflect the given data file state
+    bool isCurrent(const FileHeader& data) const {
+        return loaded && dataRecordCount == data.record_count && dataChecksum == data.checksum;
+    }
+    bool load(const FileHeader& data);
+    bool save(const FileHeader& data);
+    void rebuild(const std::vector<EmployeeRecord>& slots);
+    bool record(const std::vector<AttributeChange>& changes, const FileHeader& before, const FileHeader& after);
+    bool sync(const FileHeader& before, const FileHeader& after);
+
+    std::vector<int> byGrade(char grade) const;
+    std::vector<int> byDesignation(std::string_view designation) const;
+    std::vector<int> byNamePrefix(std::string_view prefix) const;
+    std::vector<int> byJoinDate(int from, int to) const;
+    // Every code in the order of the attribute's keys, ties in code order
+    std::vector<int> inKeyOrder(Attribute attribute) const;
+
+private:
+    std::string fileName;
+    bool loaded = false;
+    uint32_t dataRecordCount = 0;
+    uint32_t dataChecksum = 0;
+    KeyList<1> grades;
+    KeyList<DESIGNATION_WIDTH> designations;
+    KeyList<NAME_WIDTH> names;
+    KeyList<JOINED_WIDTH> joined;
+
+    void apply(const std::vector<AttributeChange>& changes);
+    bool readHeader(std::fstream& file, AttributeHeader& header, const FileHeader& data);
+};
+
+void joinedKey(char* key, int d, int m, int y) {
+    char text[16];
+    std::snprintf(text, sizeof(text), "%04d%02d%02d", y % 10000, m % 100, d % 100);
+    std::memcpy(key, text, JOINED_WIDTH);
+}
+
+// Adds the four keys of one record to changes, as additions or removals
+void appendAttributeChanges(std::vector<AttributeChange>& changes, const EmployeeRecord& rec, bool removed) {
+    AttributeChange change;
+    std::memset(&change, 0, sizeof(change));
+    change.removed = removed ? 1 : 0;
+    change.code = rec.code;
+
+    change.attribute = ATTRIBUTE_GRADE;
+    change.key[0] = rec.grade;
+    changes.push_back(change);
+
+    change.attribute = ATTRIBUTE_DESIGNATION;
+    std::memset(change.key, 0, sizeof(change.key));
+    std::memcpy(change.key, rec.designation, DESIGNATION_WIDTH);
+    changes.push_back(change);
+
+    change.attribute = ATTRIBUTE_NAME;
+    std::memcpy(change.key, rec.name, NAME_WIDTH);
+    changes.push_back(change);
+
+    change.attribute = ATTRIBUTE_JOINED;
+    std::memset(change.key, 0, sizeof(change.key));
+    joinedKey(change.key, rec.dd, rec.mm, rec.yy);
+    changes.push_back(change);
+}
+
+// Applies log records in order. Consecutive additions are merged as a batch;
+// a removal first flushes the additions before it, so add-then-remove of the
+// same key still ends with the key gone.
+void AttributeIndex::apply(const std::vector<AttributeChange>& changes) {
+    std::vector<KeyEntry<1>> addedGrades;
+    std::vector<KeyEntry<DESIGNATION_WIDTH>> addedDesignations;
+    std::vector<KeyEntry<NAME_WIDTH>> addedNames;
+    std::vector<KeyEntry<JOINED_WIDTH>> addedJoined;
+    auto flush = [&]() {
+        grades.add(addedGrades);
+        designations.add(addedDesignations);
+        names.add(addedNames);
+        joined.add(addedJoined);
+    };
+
+    for (const auto& change : changes) {
+        if (change.removed) {
+            flush();
+        }
+        switch (change.attribute) {
+            case ATTRIBUTE_GRADE: {
+                auto entry = KeyList<1>::makeEntry(change.key, change.code);
+                if (change.removed) grades.remove(entry); else addedGrades.push_back(entry);
+                break;
+            }
+            case ATTRIBUTE_DESIGNATION: {
+                auto entry = KeyList<DESIGNATION_WIDTH>::makeEntry(change.key, change.code);
+                if (change.removed) designations.remove(entry); else addedDesignations.push_back(entry);
+                break;
+            }
+            case ATTRIBUTE_NAME: {
+                auto entry = KeyList<NAME_WIDTH>::makeEntry(change.key, change.code);
+                if (change.removed) names.remove(entry); else addedNames.push_back(entry);
+                break;
+            }
+            case ATTRIBUTE_JOINED: {
+                auto entry = KeyList<JOINED_WIDTH>::makeEntry(change.key, change.code);
+                if (change.removed) joined.remove(entry); else addedJoined.push_back(entry);
+                break;
+            }
+        }
+    }
+    flush();
+}
+
+// Reads the header and checks that the file is in step with the data file
+bool AttributeIndex::readHeader(std::fstream& file, AttributeHeader& header, const FileHeader& data) {
+    return file.read(reinterpret_cast<char*>(&header), sizeof(AttributeHeader)) &&
+           std::memcmp(header.magic, ATTRIBUTE_MAGIC, sizeof(ATTRIBUTE_MAGIC)) == 0 &&
+           header.version == ATTRIBUTE_VERSION &&
+           header.data_record_count == data.record_count &&
+           header.data_checksum == data.checksum;
+}
+
+template <size_t Width>
+bool readKeys(std::istream& file, KeyList<Width>& list, uint32_t count) {
+    if (static_cast<uint64_t>(count) * sizeof(KeyEntry<Width>) > bytesRemaining(file)) {
+        return false;
+    }
+    list.entries.resize(count);
+    return static_cast<bool>(file.read(reinterpret_cast<char*>(list.entries.data()),
+                                       list.entries.size() * sizeof(KeyEntry<Width>)));
+}
+
+template <size_t Width>
+void writeKeys(std::ostream& file, const KeyList<Width>& list) {
+    file.write(reinterpret_cast<const char*>(list.entries.data()), list.entries.size() * sizeof(KeyEntry<Width>));
+}
+
+size_t snapshotBytes(const AttributeHeader& header) {
+    return header.snapshot_count[ATTRIBUTE_GRADE] * sizeof(KeyEntry<1>) +
+           header.snapshot_count[ATTRIBUTE_DESIGNATION] * sizeof(KeyEntry<DESIGNATION_WIDTH>) +
+           header.snapshot_count[ATTRIBUTE_NAME] * sizeof(KeyEntry<NAME_WIDTH>) +
+           header.snapshot_count[ATTRIBUTE_JOINED] * sizeof(KeyEntry<JOINED_WIDTH>);
+}
+
+// Loads the snapshot and replays the log. Once the log holds more than an
+// eighth of the snapshot, the merged lists are written back as a new snapshot.
+bool AttributeIndex::load(const FileHeader& data) {
+    loaded = false;
+    std::fstream file(fileName, std::ios::binary | std::ios::in);
+    AttributeHeader header;
+    if (!file.is_open() || !readHeader(file, header, data) ||
+        !readKeys(file, grades, header.snapshot_count[ATTRIBUTE_GRADE]) ||
+        !readKeys(file, designations, header.snapshot_count[ATTRIBUTE_DESIGNATION]) ||
+        !readKeys(file, names, header.snapshot_count[ATTRIBUTE_NAME]) ||
+        !readKeys(file, joined, header.snapshot_count[ATTRIBUTE_JOINED])) {
+        return false;
+    }
+
+    if (static_cast<uint64_t>(header.log_count) * sizeof(AttributeChange) > bytesRemaining(file)) {
+        return false;
+    }
+    std::vector<AttributeChange> changes(header.log_count);
+    if (!file.read(reinterpret_cast<char*>(changes.data()), changes.size() * sizeof(AttributeChange))) {
+        return false;
+    }
+    file.close();
+    apply(changes);
+    loaded = true;
+    dataRecordCount = data.record_count;
+    dataChecksum = data.checksum;
+
+    if (header.log_count > 1024 && header.log_count * 8 > header.snapshot_count[ATTRIBUTE_NAME] * ATTRIBUTE_COUNT) {
+        save(data);
+    }
+    return true;
+}
+
+bool AttributeIndex::save(const FileHeader& data) {
+    AttributeHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, ATTRIBUTE_MAGIC, sizeof(ATTRIBUTE_MAGIC));
+    header.version = ATTRIBUTE_VERSION;
+    header.data_record_count = data.record_count;
+    header.data_checksum = data.checksum;
+    header.snapshot_count[ATTRIBUTE_GRADE] = static_cast<uint32_t>(grades.entries.size());
+    header.snapshot_count[ATTRIBUTE_DESIGNATION] = static_cast<uint32_t>(designations.entries.size());
+    header.snapshot_count[ATTRIBUTE_NAME] = static_cast<uint32_t>(names.entries.size());
+    header.snapshot_count[ATTRIBUTE_JOINED] = static_cast<uint32_t>(joined.entries.size());
+    dataRecordCount = data.record_count;
+    dataChecksum = data.checksum;
+
+    const std::string tempName = processTempName(fileName);
+    std::ofstream file(tempName, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(AttributeHeader));
+    writeKeys(file, grades);
+    writeKeys(file, designations);
+    writeKeys(file, names);
+    writeKeys(file, joined);
+    file.close();
+    return replaceFile(tempName, fileName, static_cast<bool>(file));
+}
+
+void AttributeIndex::rebuild(const std::vector<EmployeeRecord>& slots) {
+    grades.entries.clear();
+    designations.entries.clear();
+    names.entries.clear();
+    joined.entries.clear();
+
+    std::vector<KeyEntry<1>> addedGrades;
+    std::vector<KeyEntry<DESIGNATION_WIDTH>> addedDesignations;
+    std::vector<KeyEntry<NAME_WIDTH>> addedNames;
+    std::vector<KeyEntry<JOINED_WIDTH>> addedJoined;
+    addedGrades.reserve(slots.size());
+    addedDesignations.reserve(slots.size());
+    addedNames.reserve(slots.size());
+    addedJoined.reserve(slots.size());
+    for (const auto& rec : slots) {
+        if (rec.flags & RECORD_DELETED) continue;
+        char date[JOINED_WIDTH];
+        joinedKey(date, rec.dd, rec.mm, rec.yy);
+        addedGrades.push_back(KeyList<1>::makeEntry(&rec.grade, rec.code));
+        addedDesignations.push_back(KeyList<DESIGNATION_WIDTH>::makeEntry(rec.designation, rec.code));
+        addedNames.push_back(KeyList<NAME_WIDTH>::makeEntry(rec.name, rec.code));
+        addedJoined.push_back(KeyList<JOINED_WIDTH>::makeEntry(date, rec.code));
+    }
+    grades.add(addedGrades);
+    designations.add(addedDesignations);
+    names.add(addedNames);
+    joined.add(addedJoined);
+    loaded = true;
+    dataRecordCount = 0;
+    dataChecksum = 0;
+}
+
+// Appends changes to the log and moves the header to the new data file
+// state. If the file was not in step with the data file before the change,
+// it is left alone; it is stale either way and will be rebuilt on next use.
+bool AttributeIndex::record(const std::vector<AttributeChange>& changes,
+                            const FileHeader& before, const FileHeader& after) {
+    std::fstream file(fileName, std::ios::binary | std::ios::in | std::ios::out);
+    AttributeHeader header;
+    if (!file.is_open() || !readHeader(file, header, before)) {
+        loaded = false;
+        return true;
+    }
+
+    file.seekp(sizeof(AttributeHeader) + snapshotBytes(header) + header.log_count * sizeof(AttributeChange),
+               std::ios::beg);
+    file.write(reinterpret_cast<const char*>(changes.data()), changes.size() * sizeof(AttributeChange));
+    header.log_count += static_cast<uint32_t>(changes.size());
+    header.data_record_count = after.record_count;
+    header.data_checksum = after.checksum;
+    file.seekp(0, std::ios::beg);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(AttributeHeader));
+    file.flush();
+
+    if (isCurrent(before)) {
+        apply(changes);
+        dataRecordCount = after.record_count;
+        dataChecksum = after.checksum;
+    } else {
+        loaded = false;
+    }
+    return static_cast<bool>(file);
+}
+
+// Records that the data file changed without changing any live record
+bool AttributeIndex::sync(const FileHeader& before, const FileHeader& after) {
+    return record({}, before, after);
+}
+
+std::vector<int> AttributeIndex::byGrade(char grade) const {
+    std::vector<int> codes;
+    grades.collect(&grade, &grade, 1, codes);
+    return codes;
+}
+
+std::vector<int> AttributeIndex::byDesignation(std::string_view designation) const {
+    char key[DESIGNATION_WIDTH] = {};
+    std::memcpy(key, designation.data(), std::min(designation.size(), sizeof(key)));
+    std::vector<int> codes;
+    designations.collect(key, key, sizeof(key), codes);
+    return codes;
+}
+
+std::vector<int> AttributeIndex::byNamePrefix(std::string_view prefix) const {
+    std::vector<int> codes;
+    if (prefix.size() <= NAME_WIDTH) {
+        names.collect(prefix.data(), prefix.data(), prefix.size(), codes);
+    }
+    return codes;
+}
+
+// Inclusive range of yyyymmdd dates
+std::vector<int> AttributeIndex::byJoinDate(int from, int to) const {
+    char low[JOINED_WIDTH + 1], high[JOINED_WIDTH + 1];
+    std::snprintf(low, sizeof(low), "%08d", std::max(0, std::min(from, 99999999)));
+    std::snprintf(high, sizeof(high), "%08d", std::max(0, std::min(to, 99999999)));
+    std::vector<int> codes;
+    joined.collect(low, high, JOINED_WIDTH, codes);
+    return codes;
+}
+
+std::vector<int> AttributeIndex::inKeyOrder(Attribute attribute) const {
+    std::vector<int> codes;
+    auto append = [&codes](const auto& list) {
+        codes.reserve(list.entries.size());
+        for (const auto& entry : list.entries) codes.push_back(entry.code);
+    };
+    switch (attribute) {
+        case ATTRIBUTE_GRADE: append(grades); break;
+        case ATTRIBUTE_DESIGNATION: append(designations); break;
+        case ATTRIBUTE_NAME: append(names); break;
+        default: append(joined); break;
+    }
+    return codes;
+}
+
+// Criteria for a filtered query; unset criteria match everyone
+struct EmployeeQuery {
+    char grade = 0;
+    std::string designation;
+    std::string namePrefix;
+    int joinedFrom = 0;         // yyyymmdd, inclusive
+    int joinedTo = 99991231;    // yyyymmdd, inclusive
+
+    bool hasCriteria() const {
+        return grade != 0 || !designation.empty() || !namePrefix.empty() ||
+               joinedFrom > 0 || joinedTo < 99991231;
+    }
+};
+
+// Orders a listing can be sorted in
+enum ListOrder {
+    ORDER_CODE,
+    ORDER_NAME,
+    ORDER_GRADE,
+    ORDER_SALARY
+};
+
+bool parseListOrder(const std::string& text, ListOrder& order) {
+    const char* const names[] = {"code", "name", "grade", "salary"};
+    for (int i = 0; i < 4; i++) {
+        if (text == names[i]) {
+            order = static_cast<ListOrder>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Flushes a stdio stream and forces its contents to stable storage
+bool syncStream(FILE* file) {
+    if (std::fflush(file) != 0) {
+        return false;
+    }
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+// Forces everything written to the named file so far to stable storage
+bool syncFile(const std::string& fileName) {
+    FILE* file = std::fopen(fileName.c_str(), "rb+");
+    if (!file) {
+        return false;
+    }
+    bool synced = syncStream(file);
+    std::fclose(file);
+    return synced;
+}
+
+// Write-ahead journal (EMPLOYEE.JNL). Each change to the data file is first
+// appended here as one transaction holding the after-images of the changed
+// slots and of the header, and synced; only then is the data file written in
+// place. Transactions left in the journal are applied again at startup, which
+// is safe because they are after-images, so an edit interrupted part way can
+// always be rolled forward. A transaction with a bad checksum or a short
+// tail was never committed and ends the replay. Once the data file itself has
+// been synced the journal is emptied (a checkpoint).
+const std::string JOURNAL_FILE_NAME = "EMPLOYEE.JNL";
+const char JOURNAL_MAGIC[4] = {'P', 'J', 'N', 'L'};
+
+// Journal size that triggers a checkpoint, and the amount a group commit
+// may buffer before syncing part way
+const size_t JOURNAL_CHECKPOINT_BYTES = 1 << 20;
+const size_t GROUP_COMMIT_BYTES = 16 << 20;
+
+#pragma pack(push, 1)
+struct JournalTransaction {
+    char magic[4];
+    uint32_t slot_count;
+    uint32_t checksum;      // FNV-1a over the header and slot images
+    uint32_t reserved;
+};
+
+struct JournalSlot {
+    uint32_t slot;
+    EmployeeRecord rec;
+};
+#pragma pack(pop)
+
+class Journal {
+public:
+    explicit Journal(const std::string& fileName) : fileName(fileName) {}
+    ~Journal() { close(); }
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    bool append(const FileHeader& header, const std::vector<JournalSlot>& slots, bool durable);
+    bool sync();
+    bool truncate();
+    size_t replay(const std::string& dataFile);
+    size_t size() const { return bytes; }
+
+private:
+    std::string fileName;
+    FILE* file = nullptr;
+    size_t bytes = 0;
+
+    bool openForAppend();
+    void close();
+};
+
+bool Journal::openForAppend() {
+    if (file) {
+        return true;
+    }
+    file = std::fopen(fileName.c_str(), "ab");
+    if (!file) {
+        return false;
+    }
+    std::fseek(file, 0, SEEK_END);
+    long end = std::ftell(file);
+    bytes = end > 0 ? static_cast<size_t>(end) : 0;
+    return true;
+}
+
+void Journal::close() {
+    if (file) {
+        std::fclose(file);
+        file = nullptr;
+    }
+}
+
+// Writes one transaction with a single write. With durable set it is synced
+// before returning; otherwise it waits for the next sync() (group commit).
+bool Journal::append(const FileHeader& header, const std::vector<JournalSlot>& slots, bool durable) {
+    ScopedTimer timer(METRIC_JOURNAL);
+    if (!openForAppend()) {
+        return false;
+    }
+
+    JournalTransaction transaction;
+    std::memset(&transaction, 0, sizeof(transaction));
+    std::memcpy(transaction.magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    transaction.slot_count = static_cast<uint32_t>(slots.size());
+    transaction.checksum = fnv1a(slots.data(), slots.size() * sizeof(JournalSlot),
+                                 fnv1a(&header, sizeof(FileHeader)));
+
+    std::string buffer;
+    buffer.reserve(sizeof(JournalTransaction) + sizeof(FileHeader) + slots.size() * sizeof(JournalSlot));
+    buffer.append(reinterpret_cast<const char*>(&transaction), sizeof(JournalTransaction));
+    buffer.append(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
+    buffer.append(reinterpret_cast<const char*>(slots.data()), slots.size() * sizeof(JournalSlot));
+
+    if (std::fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size()) {
+        return false;
+    }
+    bytes += buffer.size();
+    countBytesWritten(buffer.size());
+    return durable ? syncStream(file) : std::fflush(file) == 0;
+}
+
+bool Journal::sync() {
+    return !file || syncStream(file);
+}
+
+// Empties the journal. The truncation is synced too, so a crash cannot bring
+// back transactions older than a later full rewrite of the data file.
+bool Journal::truncate() {
+    close();
+    file = std::fopen(fileName.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bytes = 0;
+    return syncStream(file);
+}
+
+// Finishes an interrupted change. If the data file header is not the one the
+// last committed transaction left, every committed transaction is applied
+// again, the data file synced and the journal emptied. A journal whose last
+// transaction already reached the data file needs nothing; it is left for
+// the next checkpoint. Returns the number of transactions applied.
+size_t Journal::replay(const std::string& dataFile) {
+    close();
+    std::ifstream in(fileName, std::ios::binary);
+    if (!in.is_open()) {
+        return 0;
+    }
+
+    struct Committed {
+        FileHeader header;
+        std::vector<JournalSlot> slots;
+    };
+    std::vector<Committed> committed;
+    JournalTransaction transaction;
+    Committed next;
+    while (in.read(reinterpret_cast<char*>(&transaction), sizeof(JournalTransaction)) &&
+           std::memcmp(transaction.magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) == 0 &&
+           in.read(reinterpret_cast<char*>(&next.header), sizeof(FileHeader))) {
+        // A torn or damaged transaction header ends the log like any other
+        if (static_cast<uint64_t>(transaction.slot_count) * sizeof(JournalSlot) > bytesRemaining(in)) {
+            break;
+        }
+        next.slots.resize(transaction.slot_count);
+        if (!in.read(reinterpret_cast<char*>(next.slots.data()), next.slots.size() * sizeof(JournalSlot)) ||
+            fnv1a(next.slots.data(), next.slots.size() * sizeof(JournalSlot),
+                  fnv1a(&next.header, sizeof(FileHeader))) != transaction.checksum) {
+            break;
+        }
+        committed.push_back(std::move(next));
+    }
+    in.close();
+
+    std::fstream data(dataFile, std::ios::binary | std::ios::in | std::ios::out);
+    FileHeader current;
+    if (!data.is_open() || committed.empty() ||
+        !data.read(reinterpret_cast<char*>(&current), sizeof(FileHeader))) {
+        truncate();
+        return 0;
+    }
+    if (std::memcmp(&current, &committed.back().header, sizeof(FileHeader)) == 0) {
+        return 0;
+    }
+
+    for (const auto& change : committed) {
+        for (const auto& entry : change.slots) {
+            data.seekp(recordOffset(entry.slot), std::ios::beg);
+            data.write(reinterpret_cast<const char*>(&entry.rec), sizeof(EmployeeRecord));
+        }
+        data.seekp(0, std::ios::beg);
+        data.write(reinterpret_cast<const char*>(&change.header), sizeof(FileHeader));
+    }
+    data.close();
+    if (data && syncFile(dataFile)) {
+        truncate();     // Otherwise kept, so the next start tries again
+    }
+    return committed.size();
+}
+
+// Change list (EMPLOYEE.CHG): codes of the employees added, modified or
+// deleted since the last payroll run, so the next run recomputes only those.
+// The header holds the data file header the list starts from, which the
+// payroll run resets to the state it computed against. Codes are appended
+// before the change itself is made, so an interrupted change can only make
+// the list longer than needed. Nothing is listed until a payroll run has
+// created the file; a change that cannot be listed deletes it, which makes
+// the next run recompute everyone.
+const std::string CHANGES_FILE_NAME = "EMPLOYEE.CHG";
+const char CHANGES_MAGIC[4] = {'P', 'C', 'H', 'G'};
+
+#pragma pack(push, 1)
+struct ChangesHeader {
+    char magic[4];
+    uint32_t reserved;
+    FileHeader base;
+};
+#pragma pack(pop)
+
+class ChangeList {
+public:
+    explicit ChangeList(const std::string& fileName) : fileName(fileName) {}
+
+    void record(const std::vector<int32_t>& codes);
+    // Fails for a list longer than maxCodes, which is then no cheaper than
+    // recomputing everyone
+    bool read(FileHeader& base, std::vector<int32_t>& codes, size_t maxCodes) const;
+    bool reset(const FileHeader& base);
+    void invalidate() { std::remove(fileName.c_str()); }
+
+private:
+    std::string fileName;
+};
+
+void ChangeList::record(const std::vector<int32_t>& codes) {
+    FILE* file = std::fopen(fileName.c_str(), "r+b");
+    if (!file) {
+        return;     // No payroll run to keep track for
+    }
+    bool written = std::fseek(file, 0, SEEK_END) == 0 &&
+                   std::fwrite(codes.data(), sizeof(int32_t), codes.size(), file) == codes.size();
+    if (std::fclose(file) != 0 || !written) {
+        invalidate();
+    }
+}
+
+bool ChangeList::read(FileHeader& base, std::vector<int32_t>& codes, size_t maxCodes) const {
+    std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+    ChangesHeader header;
+    std::streamoff size = file.is_open() ? static_cast<std::streamoff>(file.tellg()) : 0;
+    if (size < static_cast<std::streamoff>(sizeof(ChangesHeader)) || !file.seekg(0, std::ios::beg) ||
+        !file.read(reinterpret_cast<char*>(&header), sizeof(ChangesHeader)) ||
+        std::memcmp(header.magic, CHANGES_MAGIC, sizeof(CHANGES_MAGIC)) != 0) {
+        return false;
+    }
+    base = header.base;
+    uint64_t count = static_cast<uint64_t>(size - sizeof(ChangesHeader)) / sizeof(int32_t);
+    if (count > maxCodes) {
+        return false;
+    }
+    codes.resize(static_cast<size_t>(count));
+    return static_cast<bool>(file.read(reinterpret_cast<char*>(codes.data()), codes.size() * sizeof(int32_t)));
+}
+
+bool ChangeList::reset(const FileHeader& base) {
+    ChangesHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, CHANGES_MAGIC, sizeof(CHANGES_MAGIC));
+    header.base = base;
+
+    const std::string tempName = processTempName(fileName);
+    std::ofstream file(tempName, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(ChangesHeader));
+    file.close();
+    return replaceFile(tempName, fileName, static_cast<bool>(file));
+}
+
+// Advisory locks shared by every process using the same data file, held on
+// "<data file>.LCK". Byte 0 is the writer lock: it serialises changes, so
+// code allocation is atomic and appends never interleave. Byte 1 guards the
+// data and index files: readers take it shared for the moment they read
+// them, writers exclusively only while they apply a change, so lookups wait
+// for at most one edit rather than for a whole import. Reads from a mapped
+// roster take no lock at all. Locks nest; only the outermost acquire and
+// release reach the operating system. The locks are fcntl() record locks on
+// Unix-like systems and LockFileEx() byte-range locks on Windows.
+const int WRITER_LOCK = 0;
+const int DATA_LOCK = 1;
+
+enum LockMode {
+    LOCK_NONE,
+    LOCK_SHARED,
+    LOCK_EXCLUSIVE
+};
+
+class FileLock {
+public:
+    explicit FileLock(const std::string& fileName) : fileName(fileName) {}
+    ~FileLock();
+
+    FileLock(const FileLock&) = delete;
+    FileLock& operator=(const FileLock&) = delete;
+
+    bool acquire(int byte, bool exclusive);
+    bool tryAcquire(int byte);
+    void release(int byte);
+
+private:
+    std::string fileName;
+#ifdef _WIN32
+    HANDLE handle = INVALID_HANDLE_VALUE;
+    bool osHeld[2] = {false, false};
+#else
+    int fd = -1;
+#endif
+    int depth[2] = {0, 0};
+    bool exclusiveHeld[2] = {false, false};
+
+    bool setLock(int byte, LockMode mode, bool wait = true);
+};
+
+FileLock::~FileLock() {
+#ifdef _WIN32
+    if (handle != INVALID_HANDLE_VALUE) {
+        CloseHandle(handle);
+    }
+#else
+    if (fd >= 0) {
+        ::close(fd);
+    }
+#endif
+}
+
+// One descriptor is kept for the life of the store: fcntl locks belong to the
+// process and closing any descriptor of the lock file would drop them all.
+// Windows locks belong to the handle and do not convert in place, so a held
+// byte is unlocked before it is locked again in the new mode.
+bool FileLock::setLock(int byte, LockMode mode, bool wait) {
+#ifdef _WIN32
+    if (handle == INVALID_HANDLE_VALUE) {
+        handle = CreateFileA(fileName.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                             nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (handle == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+    }
+    OVERLAPPED region;
+    std::memset(&region, 0, sizeof(region));
+    region.Offset = static_cast<DWORD>(byte);
+    if (osHeld[byte]) {
+        UnlockFileEx(handle, 0, 1, 0, &region);
+        osHeld[byte] = false;
+    }
+    if (mode == LOCK_NONE) {
+        return true;
+    }
+    DWORD flags = (mode == LOCK_EXCLUSIVE ? LOCKFILE_EXCLUSIVE_LOCK : 0) | (wait ? 0 : LOCKFILE_FAIL_IMMEDIATELY);
+    if (!LockFileEx(handle, flags, 0, 1, 0, &region)) {
+        return false;
+    }
+    osHeld[byte] = true;
+#else
+    if (fd < 0) {
+        fd = ::open(fileName.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) {
+            return false;
+        }
+    }
+    struct flock region;
+    std::memset(&region, 0, sizeof(region));
+    region.l_type = mode == LOCK_EXCLUSIVE ? F_WRLCK : mode == LOCK_SHARED ? F_RDLCK : F_UNLCK;
+    region.l_whence = SEEK_SET;
+    region.l_start = byte;
+    region.l_len = 1;
+    while (fcntl(fd, wait ? F_SETLKW : F_SETLK, &region) == -1) {
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+#endif
+    return true;
+}
+
+bool FileLock::acquire(int byte, bool exclusive) {
+    if (depth[byte] > 0) {
+        if (exclusive && !exclusiveHeld[byte]) {
+            if (!setLock(byte, LOCK_EXCLUSIVE)) {
+                return false;
+            }
+            exclusiveHeld[byte] = true;
+        }
+        depth[byte]++;
+        return true;
+    }
+    if (!setLock(byte, exclusive ? LOCK_EXCLUSIVE : LOCK_SHARED)) {
+        return false;
+    }
+    exclusiveHeld[byte] = exclusive;
+    depth[byte] = 1;
+    return true;
+}
+
+// Takes the lock exclusively only if no other process holds it
+bool FileLock::tryAcquire(int byte) {
+    if (depth[byte] > 0) {
+        return acquire(byte, true);
+    }
+    if (!setLock(byte, LOCK_EXCLUSIVE, false)) {
+        return false;
+    }
+    exclusiveHeld[byte] = true;
+    depth[byte] = 1;
+    return true;
+}
+
+void FileLock::release(int byte) {
+    if (depth[byte] > 0 && --depth[byte] == 0) {
+        setLock(byte, LOCK_NONE);
+        exclusiveHeld[byte] = false;
+    }
+}
+
+class LockGuard {
+public:
+    LockGuard(FileLock& lock, int byte, bool exclusive) : lock(lock), byte(byte) {
+        held = lock.acquire(byte, exclusive);
+    }
+    ~LockGuard() {
+        if (held) lock.release(byte);
+    }
+
+    LockGuard(const LockGuard&) = delete;
+    LockGuard& operator=(const LockGuard&) = delete;
+
+    bool locked() const { return held; }
+
+private:
+    FileLock& lock;
+    int byte;
+    bool held;
+};
+
+bool sameState(const FileHeader& a, const FileHeader& b) {
+    return a.record_count == b.record_count && a.checksum == b.checksum;
+}
+
+// Slot-based access to one employee data file plus its code and attribute
+// indexes and its journal. Single-record operations are journaled, then
+// touch one slot and the header; the header is written last so an
+// interrupted append is simply not counted. Several processes may share the
+// files; see FileLock.
+class EmployeeStore {
+public:
+    explicit EmployeeStore(const std::string& dataFile = FILE_NAME,
+                           const std::string& indexFile = INDEX_FILE_NAME,
+                           const std::string& attributeFile = ATTRIBUTE_INDEX_FILE_NAME,
+                           const std::string& journalFile = JOURNAL_FILE_NAME,
+                           const std::string& changesFile = CHANGES_FILE_NAME)
+        : dataFile(dataFile), index(indexFile), attributes(attributeFile), journal(journalFile),
+          changes(changesFile), locks(dataFile + ".LCK") {}
+
+    // A clean shutdown leaves an empty journal, so anything found in it at
+    // startup is a change that was interrupted
+    ~EmployeeStore() {
+        commitGroup();
+        checkpoint(true);
+    }
+
+    const std::string& fileName() const { return dataFile; }
+    bool open();
+
+    bool readFileHeader(FileHeader& header);
+    bool readSlots(std::vector<EmployeeRecord>& slots, FileHeader& header);
+    // Every live employee, text held in one arena
+    EmployeeTable readAllRecords();
+    bool writeAllRecords(const std::vector<Employee>& records);
+
+    long findRecord(int code, Employee* out = nullptr);
+    const EmployeeRecord* findRecord(const MappedRoster& roster, int code);
+    int nextEmployeeCode();
+
+    // Appends assign each employee the next code under the writer lock and
+    // store it back into emp.code
+    bool appendRecord(Employee& emp);
+    bool appendRecords(std::vector<Employee>& batch);
+
+    // Both follow the employee if another process has moved it to a new slot.
+    // With original given, the update is refused with UPDATE_CONFLICT if the
+    // stored record no longer matches it, i.e. someone else changed the
+    // employee meanwhile.
+    enum UpdateStatus {
+        UPDATE_DONE,
+        UPDATE_FAILED,
+        UPDATE_CONFLICT
+    };
+    UpdateStatus updateRecord(uint32_t slot, const Employee& emp, const Employee* original = nullptr);
+    bool deleteRecord(uint32_t slot, int code);
+
+    bool compactRecords();
+    bool needsCompaction();
+
+    // Group commit: appends between beginGroup() and commitGroup() share one
+    // journal sync, and the header and indexes are written once at the end.
+    // The writer lock is held for the whole group.
+    bool beginGroup();
+    bool commitGroup();
+
+    std::vector<int> queryCodes(const EmployeeQuery& query);
+    // Every code in the given order, read from the code or attribute index.
+    // Returns false for an order that no index keeps (salary).
+    bool orderedCodes(ListOrder order, std::vector<int>& codes);
+
+    // Holds off writers in every process for the guard's lifetime
+    LockGuard lockWriters() { return LockGuard(locks, WRITER_LOCK, true); }
+
+    // Employees changed since the change list was last reset to base
+    bool readChanges(FileHeader& base, std::vector<int32_t>& codes, size_t maxCodes) const {
+        return changes.read(base, codes, maxCodes);
+    }
+    bool resetChanges(const FileHeader& base) { return changes.reset(base); }
+
+    // Called after each single add, modify or delete is written, with the
+    // data file header before and after it and the slots it wrote. Group
+    // commits and full rewrites are not reported.
+    using ChangeListener =
+        std::function<void(const FileHeader& before, const FileHeader& after, const std::vector<JournalSlot>& slots)>;
+    void setChangeListener(ChangeListener listener) { changeListener = std::move(listener); }
+
+    // Where new codes come from when codes are shared with other files (see
+    // BranchManifest). Given the last code this file issued, returns the next
+    // code, or 0 if none can be had. With lease false it only predicts the
+    // code and reserves nothing. Without a source codes simply count up.
+    using CodeSource = std::function<int(int lastCode, bool lease)>;
+    void setCodeSource(CodeSource source) { codeSource = std::move(source); }
+
+private:
+    std::string dataFile;
+    CodeIndex index;
+    AttributeIndex attributes;
+    Journal journal;
+    ChangeList changes;
+    FileLock locks;
+    bool indexLoaded = false;
+    FileHeader indexedHeader{};         // Data file state the index reflects
+    bool grouping = false;
+    bool groupPending = false;
+    FileHeader groupBefore{}, groupHeader{};
+    std::vector<IndexEntry> groupAdded;
+    std::vector<AttributeChange> groupChanges;
+    ChangeListener changeListener;
+    CodeSource codeSource;
+
+    bool openForUpdate(std::fstream& file, FileHeader& header);
+    bool writeHeader(std::fstream& file, const FileHeader& header);
+    bool readSlot(std::fstream& file, uint32_t slot, EmployeeRecord& rec);
+    bool rewriteRecords(const std::vector<EmployeeRecord>& slots);
+    bool locateSlot(std::fstream& file, const FileHeader& header, int code, uint32_t& slot, EmployeeRecord& rec);
+    bool ensureIndex();
+    bool ensureIndex(const FileHeader& current);
+    bool rebuildIndex();
+    bool ensureAttributes();
+    bool flushGroup();
+    bool checkpoint(bool force = false);
+};
+
+bool EmployeeStore::readFileHeader(FileHeader& header) {
+    LockGuard shared(locks, DATA_LOCK, false);
+    std::ifstream file(dataFile, std::ios::binary);
+    countBytesRead(sizeof(FileHeader));
+    return file.is_open() && readHeader(file, header, dataFile);
+}
+
+// Reads every slot, live or deleted, with one bulk read.
+bool EmployeeStore::readSlots(std::vector<EmployeeRecord>& slots, FileHeader& header) {
+    ScopedTimer timer(METRIC_STORAGE_READ);
+    LockGuard shared(locks, DATA_LOCK, false);
+    slots.clear();
+    std::ifstream file(dataFile, std::ios::binary);
+    if (!file.is_open() || !readHeader(file, header, dataFile)) {
+        return false;
+    }
+
+    slots.resize(header.record_count);
+    file.read(reinterpret_cast<char*>(slots.data()), slots.size() * sizeof(EmployeeRecord));
+    countBytesRead(sizeof(FileHeader) + static_cast<uint64_t>(file.gcount()));
+    countRecordsScanned(slots.size());
+
+    uint32_t checksum = 0;
+    for (const auto& rec : slots) {
+        checksum += recordChecksum(rec);
+    }
+    if (checksum != header.checksum) {
+        std::cerr << "Warning: " << dataFile << " checksum mismatch; records may be damaged.\n";
+    }
+    return true;
+}
+
+EmployeeTable EmployeeStore::readAllRecords() {
+    EmployeeTable table;
+    std::vector<EmployeeRecord> slots;
+    FileHeader header;
+    if (!readSlots(slots, header)) {
+        return table;
+    }
+
+    table.reserve(slots.size() - std::min<size_t>(slots.size(), header.deleted_count));
+    for (const auto& rec : slots) {
+        if (!(rec.flags & RECORD_DELETED)) {
+            table.add(rec);
+        }
+    }
+    return table;
+}
+
+// Rewrites the whole file with only the given records. Any employee may have
+// changed, so the next payroll run recomputes everyone.
+bool EmployeeStore::writeAllRecords(const std::vector<Employee>& records) {
+    LockGuard writer(locks, WRITER_LOCK, true);
+    if (!writer.locked()) {
+        return false;
+    }
+    changes.invalidate();
+
+    std::vector<EmployeeRecord> slots;
+    slots.reserve(records.size());
+    for (const auto& emp : records) {
+        slots.push_back(toRecord(emp));
+    }
+    return rewriteRecords(slots);
+}
+
+// The new contents are written beside the data file and renamed over it, so
+// a crash part way through leaves the previous roster intact.
+bool EmployeeStore::rewriteRecords(const std::vector<EmployeeRecord>& slots) {
+    ScopedTimer timer(METRIC_STORAGE_WRITE);
+    LockGuard writer(locks, WRITER_LOCK, true);
+    LockGuard data(locks, DATA_LOCK, true);
+    if (!writer.locked() || !data.locked()) {
+        return false;
+    }
+
+    FileHeader header = makeHeader();
+    header.record_count = static_cast<uint32_t>(slots.size());
+
+    // Preserve the code high-water mark so deleted codes are never reissued
+    std::ifstream existing(dataFile, std::ios::binary);
+    FileHeader previous;
+    if (existing.is_open() && readHeader(existing, previous, dataFile)) {
+        header.last_code = previous.last_code;
+    }
+    existing.close();
+
+    for (const auto& rec : slots) {
+        header.checksum += recordChecksum(rec);
+        header.last_code = std::max(header.last_code, rec.code);
+    }
+
+    const std::string tempName = dataFile + ".tmp";
+    std::ofstream file(tempName, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
+    file.write(reinterpret_cast<const char*>(slots.data()), slots.size() * sizeof(EmployeeRecord));
+    file.close();
+    countBytesWritten(sizeof(FileHeader) + slots.size() * sizeof(EmployeeRecord));
+    if (!file || !syncFile(tempName)) {
+        std::remove(tempName.c_str());
+        return false;
+    }
+
+    // Journaled slot numbers refer to the old file, so the journal must be
+    // empty before the new file takes its place
+    if (!flushGroup() || !checkpoint(true) ||
+        std::rename(tempName.c_str(), dataFile.c_str()) != 0) {
+        std::remove(tempName.c_str());
+        return false;
+    }
+
+    index.rebuild(slots);
+    indexLoaded = true;
+    indexedHeader = header;
+    return index.save(header);
+}
+
+// Opens the data file for a change; the caller holds both locks exclusively.
+bool EmployeeStore::openForUpdate(std::fstream& file, FileHeader& header) {
+    file.open(dataFile, std::ios::binary | std::ios::in | std::ios::out);
+    if (!file.is_open()) {
+        if (!writeAllRecords({})) {
+            return false;
+        }
+        file.clear();
+        file.open(dataFile, std::ios::binary | std::ios::in | std::ios::out);
+    }
+    return file.is_open() && readHeader(file, header, dataFile) && ensureIndex(header);
+}
+
+bool EmployeeStore::writeHeader(std::fstream& file, const FileHeader& header) {
+    file.seekp(0, std::ios::beg);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
+    file.flush();
+    countBytesWritten(sizeof(FileHeader));
+    return static_cast<bool>(file);
+}
+
+bool EmployeeStore::readSlot(std::fstream& file, uint32_t slot, EmployeeRecord& rec) {
+    file.seekg(recordOffset(slot), std::ios::beg);
+    return static_cast<bool>(file.read(reinterpret_cast<char*>(&rec), sizeof(EmployeeRecord)));
+}
+
+// Checks that slot still holds the live employee code. If another process
+// compacted the file since the caller looked it up, the employee is found
+// again through the (now current) index.
+bool EmployeeStore::locateSlot(std::fstream& file, const FileHeader& header, int code,
+                               uint32_t& slot, EmployeeRecord& rec) {
+    if (slot < header.record_count && readSlot(file, slot, rec) &&
+        rec.code == code && !(rec.flags & RECORD_DELETED)) {
+        return true;
+    }
+    long current = index.find(code);
+    if (current < 0 || static_cast<uint32_t>(current) >= header.record_count) {
+        return false;
+    }
+    slot = static_cast<uint32_t>(current);
+    return readSlot(file, slot, rec) && rec.code == code && !(rec.flags & RECORD_DELETED);
+}
+
+// Prepares the store at startup: finishes any change interrupted by a crash,
+// converts an older data file in place and loads the code index.
+// Recovery is skipped while another process holds the writer lock: a live
+// writer's journal is not the remains of a crash.
+bool EmployeeStore::open() {
+    if (locks.tryAcquire(WRITER_LOCK)) {
+        LockGuard data(locks, DATA_LOCK, true);
+        if (size_t recovered = journal.replay(dataFile)) {
+            std::cerr << "Note: recovered " << recovered << " interrupted change(s) to " << dataFile << " from the journal.\n";
+            indexLoaded = false;
+        }
+        if (upgradeDataFile(dataFile)) {
+            indexLoaded = false;
+        }
+        locks.release(WRITER_LOCK);
+    }
+    return ensureIndex();
+}
+
+// Syncs the data file and empties the journal, once the journal has grown
+// past JOURNAL_CHECKPOINT_BYTES or when forced.
+bool EmployeeStore::checkpoint(bool force) {
+    if (journal.size() == 0 || (!force && journal.size() < JOURNAL_CHECKPOINT_BYTES)) {
+        return true;
+    }
+    LockGuard writer(locks, WRITER_LOCK, true);
+    return writer.locked() && syncFile(dataFile) && journal.truncate();
+}
+
+bool EmployeeStore::beginGroup() {
+    if (grouping) {
+        return true;
+    }
+    grouping = locks.acquire(WRITER_LOCK, true);
+    return grouping;
+}
+
+// Makes the grouped appends so far durable, then publishes them: the header
+// first, then the index entries and attribute keys they add.
+bool EmployeeStore::flushGroup() {
+    if (!groupPending) {
+        return true;
+    }
+    LockGuard data(locks, DATA_LOCK, true);
+    groupPending = false;
+    std::fstream file(dataFile, std::ios::binary | std::ios::in | std::ios::out);
+    bool published = data.locked() && journal.sync() && file.is_open() && writeHeader(file, groupHeader);
+    file.close();
+    if (published && index.add(groupAdded, groupHeader)) {
+        indexedHeader = groupHeader;
+    } else {
+        indexLoaded = false;
+    }
+    published = published && attributes.record(groupChanges, groupBefore, groupHeader);
+    groupAdded.clear();
+    groupChanges.clear();
+    return published && checkpoint();
+}
+
+bool EmployeeStore::commitGroup() {
+    if (!grouping) {
+        return true;
+    }
+    bool committed = flushGroup();
+    grouping = false;
+    locks.release(WRITER_LOCK);
+    return committed;
+}
+
+// Loads the code index, or reloads it if the data file has changed since it
+// was loaded, rebuilding it if the file on disk is missing or stale.
+bool EmployeeStore::ensureIndex(const FileHeader& current) {
+    if (indexLoaded && sameState(indexedHeader, current)) {
+        return true;
+    }
+    LockGuard shared(locks, DATA_LOCK, false);
+    if (index.load(current)) {
+        indexLoaded = true;
+        indexedHeader = current;
+        return true;
+    }
+    return rebuildIndex();
+}
+
+bool EmployeeStore::ensureIndex() {
+    LockGuard shared(locks, DATA_LOCK, false);
+    std::ifstream file(dataFile, std::ios::binary);
+    FileHeader header;
+    if (!file.is_open() || !readHeader(file, header, dataFile)) {
+        index.rebuild({});
+        indexLoaded = true;
+        indexedHeader = makeHeader();
+        return true;
+    }
+    file.close();
+    return ensureIndex(header);
+}
+
+bool EmployeeStore::rebuildIndex() {
+    std::vector<EmployeeRecord> slots;
+    FileHeader header;
+    if (!readSlots(slots, header)) {
+        header = makeHeader();
+    }
+    index.rebuild(slots);
+    indexLoaded = true;
+    indexedHeader = header;
+    return index.save(header);
+}
+
+// Finds the live slot holding the given code; returns -1 if there is none.
+long EmployeeStore::findRecord(int code, Employee* out) {
+    ScopedTimer timer(METRIC_LOOKUP);
+    LockGuard shared(locks, DATA_LOCK, false);
+    for (int attempt = 0; attempt < 2; attempt++) {
+        std::ifstream file(dataFile, std::ios::binary);
+        FileHeader header;
+        if (!file.is_open() || !readHeader(file, header, dataFile)) {
+            return -1;
+        }
+        ensureIndex(header);
+        long slot = index.find(code);
+        if (slot < 0) {
+            return -1;
+        }
+
+        EmployeeRecord rec;
+        file.seekg(recordOffset(static_cast<uint32_t>(slot)), std::ios::beg);
+        countBytesRead(sizeof(EmployeeRecord));
+        if (file.read(reinterpret_cast<char*>(&rec), sizeof(EmployeeRecord)) &&
+            rec.code == code && !(rec.flags & RECORD_DELETED)) {
+            if (out) *out = fromRecord(rec);
+            return slot;
+        }
+
+        // The data file changed underneath the index; rebuild and retry once
+        rebuildIndex();
+    }
+    return -1;
+}
+
+// Lookup against a mapped view: the record is returned in place, uncopied.
+// The view is a snapshot, so the index is checked against its header.
+const EmployeeRecord* EmployeeStore::findRecord(const MappedRoster& roster, int code) {
+    ScopedTimer timer(METRIC_LOOKUP);
+    if (!roster.isOpen()) {
+        return nullptr;
+    }
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (!indexLoaded || !sameState(indexedHeader, roster.fileHeader())) {
+            ensureIndex();
+        }
+        long slot = index.find(code);
+        if (slot < 0) {
+            return nullptr;
+        }
+        if (static_cast<uint32_t>(slot) < roster.size()) {
+            const EmployeeRecord& rec = roster[static_cast<uint32_t>(slot)];
+            if (rec.code == code && !(rec.flags & RECORD_DELETED)) {
+                return &rec;
+            }
+        }
+        rebuildIndex();
+    }
+    return nullptr;
+}
+
+// The code the next added employee would receive. Only a preview: another
+// process may take it first, and appends assign codes themselves.
+int EmployeeStore::nextEmployeeCode() {
+    FileHeader header;
+    if (groupPending) {
+        header = groupHeader;
+    } else if (!readFileHeader(header)) {
+        header.last_code = 0;
+    }
+    return codeSource ? codeSource(header.last_code, false) : header.last_code + 1;
+}
+
+bool EmployeeStore::appendRecord(Employee& emp) {
+    std::vector<Employee> batch{emp};
+    if (!appendRecords(batch)) {
+        return false;
+    }
+    emp.code = batch[0].code;
+    return true;
+}
+
+// Appends a batch with one contiguous write and a single header update.
+bool EmployeeStore::appendRecords(std::vector<Employee>& batch) {
+    if (batch.empty()) {
+        return true;
+    }
+    ScopedTimer timer(METRIC_STORAGE_WRITE);
+    LockGuard writer(locks, WRITER_LOCK, true);
+    LockGuard data(locks, DATA_LOCK, true);
+    std::fstream file;
+    FileHeader header;
+    if (!writer.locked() || !data.locked() || !openForUpdate(file, header)) {
+        return false;
+    }
+    if (groupPending) {
+        header = groupHeader;
+    }
+
+    const FileHeader before = header;
+    uint32_t firstSlot = header.record_count;
+    std::vector<EmployeeRecord> slots;
+    std::vector<JournalSlot> logged;
+    std::vector<IndexEntry> added;
+    slots.reserve(batch.size());
+    logged.reserve(batch.size());
+    added.reserve(batch.size());
+    for (auto& emp : batch) {
+        uint32_t slot = firstSlot + static_cast<uint32_t>(slots.size());
+        emp.code = codeSource ? codeSource(header.last_code, true) : header.last_code + 1;
+        if (emp.code <= 0) {
+            std::cerr << "Error: no employee code could be allocated.\n";
+            return false;
+        }
+        header.last_code = emp.code;
+        added.push_back({emp.code, static_cast<int32_t>(slot)});
+        slots.push_back(toRecord(emp));
+        logged.push_back({slot, slots.back()});
+        header.checksum += recordChecksum(slots.back());
+    }
+    header.record_count += static_cast<uint32_t>(slots.size());
+
+    std::vector<int32_t> codes;
+    codes.reserve(added.size());
+    for (const auto& entry : added) {
+        codes.push_back(entry.code);
+    }
+    changes.record(codes);
+    if (!journal.append(header, logged, !grouping)) {
+        return false;
+    }
+    file.seekp(recordOffset(firstSlot), std::ios::beg);
+    file.write(reinterpret_cast<const char*>(slots.data()), slots.size() * sizeof(EmployeeRecord));
+    file.flush();
+    countBytesWritten(slots.size() * sizeof(EmployeeRecord));
+    if (!file) {
+        return false;
+    }
+
+    std::vector<AttributeChange> changes;
+    changes.reserve(slots.size() * ATTRIBUTE_COUNT);
+    for (const auto& rec : slots) {
+        appendAttributeChanges(changes, rec, false);
+    }
+
+    // In a group the header and indexes wait for the group's sync; until then
+    // the new slots lie beyond the counted records and readers ignore them
+    if (grouping) {
+        if (!groupPending) {
+            groupBefore = before;
+        }
+        groupHeader = header;
+        groupPending = true;
+        groupAdded.insert(groupAdded.end(), added.begin(), added.end());
+        groupChanges.insert(groupChanges.end(), changes.begin(), changes.end());
+        file.close();
+        return journal.size() < GROUP_COMMIT_BYTES || flushGroup();
+    }
+
+    if (!writeHeader(file, header) || !index.add(added, header)) {
+        return false;
+    }
+    file.close();
+    indexedHeader = header;
+    if (changeListener) {
+        changeListener(before, header, logged);
+    }
+    return attributes.record(changes, before, header) && checkpoint();
+}
+
+EmployeeStore::UpdateStatus EmployeeStore::updateRecord(uint32_t slot, const Employee& emp, const Employee* original) {
+    ScopedTimer timer(METRIC_STORAGE_WRITE);
+    LockGuard writer(locks, WRITER_LOCK, true);
+    LockGuard data(locks, DATA_LOCK, true);
+    std::fstream file;
+    FileHeader header;
+    EmployeeRecord oldRec;
+    if (!writer.locked() || !data.locked() || !flushGroup() || !openForUpdate(file, header) ||
+        !locateSlot(file, header, emp.code, slot, oldRec)) {
+        return UPDATE_FAILED;
+    }
+    if (original) {
+        EmployeeRecord expected = toRecord(*original);
+        EmployeeRecord stored = toRecord(fromRecord(oldRec));
+        if (std::memcmp(&expected, &stored, sizeof(EmployeeRecord)) != 0) {
+            return UPDATE_CONFLICT;
+        }
+    }
+
+    EmployeeRecord rec = toRecord(emp);
+    rec.flags = oldRec.flags;
+    const FileHeader before = header;
+    header.checksum += recordChecksum(rec) - recordChecksum(oldRec);
+    const std::vector<JournalSlot> logged{{slot, rec}};
+    changes.record({rec.code});
+    if (!journal.append(header, logged, true)) {
+        return UPDATE_FAILED;
+    }
+
+    file.seekp(recordOffset(slot), std::ios::beg);
+    file.write(reinterpret_cast<const char*>(&rec), sizeof(EmployeeRecord));
+    file.flush();
+    countBytesWritten(sizeof(EmployeeRecord));
+    if (!file || !writeHeader(file, header) || !index.sync(header)) {
+        return UPDATE_FAILED;
+    }
+    file.close();
+    indexedHeader = header;
+    if (changeListener) {
+        changeListener(before, header, logged);
+    }
+
+    std::vector<AttributeChange> changes;
+    appendAttributeChanges(changes, oldRec, true);
+    appendAttributeChanges(changes, rec, false);
+    return attributes.record(changes, before, header) && checkpoint() ? UPDATE_DONE : UPDATE_FAILED;
+}
+
+bool EmployeeStore::deleteRecord(uint32_t slot, int code) {
+    ScopedTimer timer(METRIC_STORAGE_WRITE);
+    LockGuard writer(locks, WRITER_LOCK, true);
+    LockGuard data(locks, DATA_LOCK, true);
+    std::fstream file;
+    FileHeader header;
+    EmployeeRecord rec;
+    if (!writer.locked() || !data.locked() || !flushGroup() || !openForUpdate(file, header)) {
+        return false;
+    }
+    if (!locateSlot(file, header, code, slot, rec)) {
+        return true;    // Already deleted
+    }
+
+    uint32_t oldChecksum = recordChecksum(rec);
+    rec.flags |= RECORD_DELETED;
+    const FileHeader before = header;
+    header.checksum += recordChecksum(rec) - oldChecksum;
+    header.deleted_count++;
+    const std::vector<JournalSlot> logged{{slot, rec}};
+    changes.record({rec.code});
+    if (!journal.append(header, logged, true)) {
+        return false;
+    }
+
+    file.seekp(recordOffset(slot), std::ios::beg);
+    file.write(reinterpret_cast<const char*>(&rec), sizeof(EmployeeRecord));
+    file.flush();
+    countBytesWritten(sizeof(EmployeeRecord));
+    if (!file || !writeHeader(file, header) || !index.remove(rec.code, header)) {
+        return false;
+    }
+    file.close();
+    indexedHeader = header;
+    if (changeListener) {
+        changeListener(before, header, logged);
+    }
+
+    std::vector<AttributeChange> changes;
+    appendAttributeChanges(changes, rec, true);
+    return attributes.record(changes, before, header) && checkpoint();
+}
+
+// Drops tombstoned slots by rewriting the live records. The live records
+// are unchanged, so the attribute index only needs its header moved on.
+bool EmployeeStore::compactRecords() {
+    LockGuard writer(locks, WRITER_LOCK, true);
+    if (!writer.locked()) {
+        return false;
+    }
+    std::ifstream file(dataFile, std::ios::binary);
+    FileHeader before;
+    bool existed = file.is_open() && readHeader(file, before, dataFile);
+    file.close();
+
+    // Live records are copied as they are, with no conversion
+    std::vector<EmployeeRecord> slots;
+    FileHeader current;
+    if (!readSlots(slots, current)) {
+        return false;
+    }
+    slots.erase(std::remove_if(slots.begin(), slots.end(),
+                               [](const EmployeeRecord& rec) { return (rec.flags & RECORD_DELETED) != 0; }),
+                slots.end());
+    if (!rewriteRecords(slots)) {
+        return false;
+    }
+
+    file.open(dataFile, std::ios::binary);
+    FileHeader after;
+    if (existed && readHeader(file, after, dataFile)) {
+        attributes.sync(before, after);
+    }
+    return true;
+}
+
+// Loads the attribute index on first use, rebuilding it if missing or stale.
+bool EmployeeStore::ensureAttributes() {
+    LockGuard shared(locks, DATA_LOCK, false);
+    std::ifstream file(dataFile, std::ios::binary);
+    FileHeader header;
+    if (!file.is_open() || !readHeader(file, header, dataFile)) {
+        attributes.rebuild({});
+        return true;
+    }
+    file.close();
+
+    if (attributes.isCurrent(header) || attributes.load(header)) {
+        return true;
+    }
+
+    std::vector<EmployeeRecord> slots;
+    readSlots(slots, header);
+    attributes.rebuild(slots);
+    return attributes.save(header);
+}
+
+// Codes of the employees matching every given criterion, in code order. Each
+// criterion is answered from the attribute index and the lists intersected.
+std::vector<int> EmployeeStore::queryCodes(const EmployeeQuery& query) {
+    ScopedTimer timer(METRIC_QUERY);
+    ensureAttributes();
+
+    std::vector<std::vector<int>> lists;
+    if (query.grade != 0) lists.push_back(attributes.byGrade(query.grade));
+    if (!query.designation.empty()) lists.push_back(attributes.byDesignation(query.designation));
+    if (!query.namePrefix.empty() || lists.empty()) lists.push_back(attributes.byNamePrefix(query.namePrefix));
+    if (query.joinedFrom > 0 || query.joinedTo < 99991231) {
+        lists.push_back(attributes.byJoinDate(query.joinedFrom, query.joinedTo));
+    }
+
+    // Intersect starting from the shortest list
+    std::sort(lists.begin(), lists.end(),
+              [](const std::vector<int>& a, const std::vector<int>& b) {
+                  return a.size() < b.size();
+              });
+    std::vector<int> codes = std::move(lists[0]);
+    std::sort(codes.begin(), codes.end());
+    for (size_t i = 1; i < lists.size() && !codes.empty(); i++) {
+        std::sort(lists[i].begin(), lists[i].end());
+        std::vector<int> common;
+        std::set_intersection(codes.begin(), codes.end(), lists[i].begin(), lists[i].end(),
+                              std::back_inserter(common));
+        codes.swap(common);
+    }
+    return codes;
+}
+
+bool EmployeeStore::orderedCodes(ListOrder order, std::vector<int>& codes) {
+    ScopedTimer timer(METRIC_QUERY);
+    switch (order) {
+        case ORDER_CODE:
+            if (!ensureIndex()) return false;
+            codes = index.liveCodes();
+            return true;
+        case ORDER_NAME:
+        case ORDER_GRADE:
+            if (!ensureAttributes()) return false;
+            codes = attributes.inKeyOrder(order == ORDER_NAME ? ATTRIBUTE_NAME : ATTRIBUTE_GRADE);
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Compaction is worthwhile once at least half the slots are tombstones
+bool EmployeeStore::needsCompaction() {
+    std::ifstream file(dataFile, std::ios::binary);
+    FileHeader header;
+    if (!file.is_open() || !readHeader(file, header, dataFile)) {
+        return false;
+    }
+    return header.deleted_count >= 64 && header.deleted_count * 2 >= header.record_count;
+}
+
+// Sorted listings. Orders an index keeps are read from it; any other order,
+// and any roster without indexes, goes through an external merge sort of
+// (key, code, slot) entries. Entries are sorted in runs of SORT_RUN_KEYS; a
+// roster that fits in one run is sorted in memory, while a larger one has its
+// runs spilled to a temporary file and merged as pages are taken, reading
+// SORT_READ_KEYS of each run at a time. Memory stays bounded by the run size
+// however large the roster.
+const size_t SORT_RUN_KEYS = 1 << 18;
+const size_t SORT_READ_KEYS = 1024;
+
+#pragma pack(push, 1)
+struct ListKey {
+    char key[NAME_WIDTH];       // Compared with memcmp
+    int32_t code;               // Breaks ties
+    uint32_t slot;
+};
+#pragma pack(pop)
+
+ListKey makeListKey(const EmployeeRecord& rec, uint32_t slot, ListOrder order) {
+    ListKey entry;
+    std::memset(entry.key, 0, sizeof(entry.key));
+    switch (order) {
+        case ORDER_NAME:
+            std::memcpy(entry.key, rec.name, NAME_WIDTH);
+            break;
+        case ORDER_GRADE:
+            entry.key[0] = rec.grade;
+            break;
+        case ORDER_SALARY: {
+            // Big-endian with the sign bit flipped, so memcmp orders it; grade
+            // E is paid by the day and sorts as no monthly salary
+            uint32_t biased = static_cast<uint32_t>(isDailyGrade(rec.grade) ? 0 : rec.basic_salary) ^ 0x80000000u;
+            for (int i = 0; i < 4; i++) {
+                entry.key[i] = static_cast<char>(biased >> (24 - 8 * i));
+            }
+            break;
+        }
+        case ORDER_CODE:
+            break;
+    }
+    entry.code = rec.code;
+    entry.slot = slot;
+    return entry;
+}
+
+bool listKeyBefore(const ListKey& a, const ListKey& b) {
+    int order = std::memcmp(a.key, b.key, sizeof(a.key));
+    return order < 0 || (order == 0 && a.code < b.code);
+}
+
+class SortedSlots {
+public:
+    SortedSlots(const MappedRoster& roster, ListOrder order, bool descending, const std::string& spillFile);
+    ~SortedSlots();
+
+    SortedSlots(const SortedSlots&) = delete;
+    SortedSlots& operator=(const SortedSlots&) = delete;
+
+    bool failed() const { return spillFailed; }
+    // Appends the next count slots in order; stops early at the end
+    void next(size_t count, std::vector<uint32_t>& slots);
+
+private:
+    struct Run {
+        uint64_t offset = 0;            // Next unread entry in the spill file
+        size_t unread = 0;
+        std::vector<ListKey> buffer;
+        size_t position = 0;
+    };
+
+    bool descending;
+    std::string spillFile;
+    std::fstream spill;
+    bool spillFailed = false;
+    std::vector<Run> runs;
+    std::vector<size_t> heap;           // Runs by their current entry
+
+    bool before(const ListKey& a, const ListKey& b) const {
+        return descending ? listKeyBefore(b, a) : listKeyBefore(a, b);
+    }
+    bool heapBefore(size_t a, size_t b) const {
+        return before(runs[b].buffer[runs[b].position], runs[a].buffer[runs[a].position]);
+    }
+    void spillRun(std::vector<ListKey>& run);
+    bool refill(Run& run);
+};
+
+SortedSlots::SortedSlots(const MappedRoster& roster, ListOrder order, bool descending, const std::string& spillFile)
+    : descending(descending), spillFile(spillFile) {
+    ScopedTimer timer(METRIC_QUERY);
+    std::vector<ListKey> run;
+    run.reserve(std::min<size_t>(roster.liveCount(), SORT_RUN_KEYS));
+    for (uint32_t slot = 0; slot < roster.size(); slot++) {
+        if (roster[slot].flags & RECORD_DELETED) continue;
+        run.push_back(makeListKey(roster[slot], slot, order));
+        if (run.size() == SORT_RUN_KEYS) {
+            spillRun(run);
+        }
+    }
+    countRecordsScanned(roster.size());
+
+    if (runs.empty()) {
+        std::sort(run.begin(), run.end(), [this](const ListKey& a, const ListKey& b) { return before(a, b); });
+        runs.emplace_back();
+        runs.back().buffer = std::move(run);
+    } else {
+        if (!run.empty()) {
+            spillRun(run);
+        }
+        for (auto& spilled : runs) {
+            refill(spilled);
+        }
+    }
+    for (size_t i = 0; i < runs.size(); i++) {
+        if (runs[i].position < runs[i].buffer.size()) {
+            heap.push_back(i);
+        }
+    }
+    std::make_heap(heap.begin(), heap.end(), [this](size_t a, size_t b) { return heapBefore(a, b); });
+}
+
+SortedSlots::~SortedSlots() {
+    if (spill.is_open()) {
+        spill.close();
+        std::remove(spillFile.c_str());
+    }
+}
+
+void SortedSlots::spillRun(std::vector<ListKey>& run) {
+    std::sort(run.begin(), run.end(), [this](const ListKey& a, const ListKey& b) { return before(a, b); });
+    if (!spill.is_open()) {
+        spill.open(spillFile, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+    }
+    Run spilled;
+    spilled.offset = runs.empty() ? 0 : runs.back().offset + runs.back().unread * sizeof(ListKey);
+    spilled.unread = run.size();
+    spill.seekp(static_cast<std::streamoff>(spilled.offset), std::ios::beg);
+    spill.write(reinterpret_cast<const char*>(run.data()), run.size() * sizeof(ListKey));
+    countBytesWritten(run.size() * sizeof(ListKey));
+    spillFailed = spillFailed || !spill;
+    runs.push_back(std::move(spilled));
+    run.clear();
+}
+
+bool SortedSlots::refill(Run& run) {
+    run.buffer.resize(std::min(run.unread, SORT_READ_KEYS));
+    run.position = 0;
+    if (run.buffer.empty() || spillFailed) {
+        run.buffer.clear();
+        return false;
+    }
+    spill.seekg(static_cast<std::streamoff>(run.offset), std::ios::beg);
+    if (!spill.read(reinterpret_cast<char*>(run.buffer.data()), run.buffer.size() * sizeof(ListKey))) {
+        spillFailed = true;
+        run.buffer.clear();
+        return false;
+    }
+    countBytesRead(run.buffer.size() * sizeof(ListKey));
+    run.offset += run.buffer.size() * sizeof(ListKey);
+    run.unread -= run.buffer.size();
+    return true;
+}
+
+void SortedSlots::next(size_t count, std::vector<uint32_t>& slots) {
+    auto order = [this](size_t a, size_t b) { return heapBefore(a, b); };
+    for (; count > 0 && !heap.empty(); count--) {
+        std::pop_heap(heap.begin(), heap.end(), order);
+        Run& run = runs[heap.back()];
+        slots.push_back(run.buffer[run.position].slot);
+        if (++run.position < run.buffer.size() || refill(run)) {
+            std::push_heap(heap.begin(), heap.end(), order);
+        } else {
+            heap.pop_back();
+        }
+    }
+}
+
+// Walks a roster page by page in list order. With a store, code, name and
+// grade order come from its indexes, so the first page costs one index load
+// and a page of lookups. Salary order, and every order of a roster without a
+// store (the merged roster of several branches), is sorted by SortedSlots.
+class RosterCursor {
+public:
+    RosterCursor(const MappedRoster& roster, EmployeeStore* store, ListOrder order, bool descending);
+
+    bool failed() const { return sorted && sorted->failed(); }
+    void skip(size_t count);
+    // The next page of up to count employees; empty at the end
+    std::vector<const EmployeeRecord*> next(size_t count);
+
+private:
+    const MappedRoster& roster;
+    EmployeeStore* store;
+    bool descending;
+    std::vector<int> codes;             // In ascending list order
+    size_t position = 0;
+    std::unique_ptr<SortedSlots> sorted;
+};
+
+RosterCursor::RosterCursor(const MappedRoster& roster, EmployeeStore* store, ListOrder order, bool descending)
+    : roster(roster), store(store), descending(descending) {
+    if (!store || !store->orderedCodes(order, codes)) {
+        this->store = nullptr;
+        std::string base = store ? store->fileName() : FILE_NAME;
+        sorted = std::make_unique<SortedSlots>(roster, order, descending, processTempName(base + ".SORT"));
+    }
+}
+
+void RosterCursor::skip(size_t count) {
+    if (sorted) {
+        std::vector<uint32_t> slots;
+        while (count > 0) {
+            slots.clear();
+            sorted->next(std::min(count, SORT_READ_KEYS), slots);
+            if (slots.empty()) break;
+            count -= slots.size();
+        }
+        return;
+    }
+    position = std::min(codes.size(), position + count);
+}
+
+std::vector<const EmployeeRecord*> RosterCursor::next(size_t count) {
+    std::vector<const EmployeeRecord*> page;
+    if (sorted) {
+        std::vector<uint32_t> slots;
+        sorted->next(count, slots);
+        for (uint32_t slot : slots) {
+            page.push_back(&roster[slot]);
+        }
+        return page;
+    }
+    // Codes the roster no longer holds (it is a snapshot) are passed over
+    while (page.size() < count && position < codes.size()) {
+        size_t i = position++;
+        int code = descending ? codes[codes.size() - 1 - i] : codes[i];
+        if (const EmployeeRecord* rec = store->findRecord(roster, code)) {
+            page.push_back(rec);
+        }
+    }
+    return page;
+}
+
+// Branch manifest (PAYROLL.MAN). A sharded roster keeps each branch's
+// employees in a store of its own; the manifest lists the branches and
+// hands out employee codes to them in blocks of CODE_BLOCK_SIZE, recording
+// which branch owns each block. Codes are therefore unique across branches,
+// and any code leads straight to the one store that can hold it.
+//
+// Layout: a ManifestHeader, branch_count BranchEntry records, then one
+// uint16_t owning branch per block; block b covers codes
+// b * CODE_BLOCK_SIZE + 1 to (b + 1) * CODE_BLOCK_SIZE. The file is replaced
+// whole under its own lock (PAYROLL.MAN.LCK), so readers need no lock.
+const std::string MANIFEST_FILE_NAME = "PAYROLL.MAN";
+const char MANIFEST_MAGIC[4] = {'P', 'M', 'A', 'N'};
+const uint32_t MANIFEST_VERSION = 1;
+const int CODE_BLOCK_SIZE = 1024;
+const size_t BRANCH_NAME_WIDTH = 16;
+const uint32_t MAX_BRANCHES = 1000;
+
+#pragma pack(push, 1)
+struct ManifestHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t branch_count;
+    uint32_t block_count;
+    uint32_t checksum;          // FNV-1a of the branch and block tables
+    uint32_t reserved;
+};
+
+struct BranchEntry {
+    char name[BRANCH_NAME_WIDTH];
+    char base[BRANCH_NAME_WIDTH + 8];   // Store file names without extension
+};
+#pragma pack(pop)
+
+static_assert(sizeof(ManifestHeader) == 24, "ManifestHeader layout changed");
+static_assert(sizeof(BranchEntry) == 40, "BranchEntry layout changed");
+
+bool isValidBranchName(const std::string& name) {
+    if (name.empty() || name.size() >= BRANCH_NAME_WIDTH) {
+        return false;
+    }
+    return std::all_of(name.begin(), name.end(), [](char c) {
+        return (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '_';
+    });
+}
+
+class BranchManifest {
+public:
+    explicit BranchManifest(const std::string& fileName = MANIFEST_FILE_NAME)
+        : fileName(fileName), locks(fileName + ".LCK") {}
+
+    BranchManifest(const BranchManifest&) = delete;
+    BranchManifest& operator=(const BranchManifest&) = delete;
+
+    bool exists() const;
+    bool load();
+
+    uint32_t size() const { return static_cast<uint32_t>(branches.size()); }
+    std::string name(uint32_t branch) const { return readField(branches[branch].name, BRANCH_NAME_WIDTH); }
+    std::string file(uint32_t branch, const char* extension) const {
+        return readField(branches[branch].base, sizeof(BranchEntry::base)) + extension;
+    }
+    long find(const std::string& name) const;
+    uint32_t blocksOwned(uint32_t branch) const;
+
+    // Branch holding code, or -1 if the code was never handed out
+    long ownerOf(int code);
+
+    // Registers a branch stored under base. The blocks covering codes up to
+    // highestCode are given to it at once, so that an existing roster can
+    // become a branch with its codes unchanged.
+    bool addBranch(const std::string& name, const std::string& base, int highestCode);
+
+    // EmployeeStore::CodeSource for the given branch
+    int nextCode(uint32_t branch, int lastCode, bool lease);
+
+private:
+    std::string fileName;
+    FileLock locks;
+    std::mutex mutex;               // Leases from several stores in one process
+    std::vector<BranchEntry> branches;
+    std::vector<uint16_t> owners;
+
+    bool save();
+};
+
+bool BranchManifest::exists() const {
+    std::ifstream file(fileName, std::ios::binary);
+    return file.is_open();
+}
+
+bool BranchManifest::load() {
+    std::ifstream file(fileName, std::ios::binary);
+    ManifestHeader header;
+    if (!file.is_open() || !file.read(reinterpret_cast<char*>(&header), sizeof(ManifestHeader)) ||
+        std::memcmp(header.magic, MANIFEST_MAGIC, sizeof(MANIFEST_MAGIC)) != 0 ||
+        header.version != MANIFEST_VERSION || header.branch_count > MAX_BRANCHES) {
+        return false;
+    }
+    if (static_cast<uint64_t>(header.branch_count) * sizeof(BranchEntry) +
+        static_cast<uint64_t>(header.block_count) * sizeof(uint16_t) > bytesRemaining(file)) {
+        std::cerr << "Warning: " << fileName << " is damaged and was ignored.\n";
+        return false;
+    }
+    std::vector<BranchEntry> readBranches(header.branch_count);
+    std::vector<uint16_t> readOwners(header.block_count);
+    if (!file.read(reinterpret_cast<char*>(readBranches.data()), readBranches.size() * sizeof(BranchEntry)) ||
+        !file.read(reinterpret_cast<char*>(readOwners.data()), readOwners.size() * sizeof(uint16_t)) ||
+        fnv1a(readOwners.data(), readOwners.size() * sizeof(uint16_t),
+              fnv1a(readBranches.data(), readBranches.size() * sizeof(BranchEntry))) != header.checksum) {
+        std::cerr << "Warning: " << fileName << " is damaged and was ignored.\n";
+        return false;
+    }
+    branches.swap(readBranches);
+    owners.swap(readOwners);
+    return true;
+}
+
+bool BranchManifest::save() {
+    ManifestHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MANIFEST_MAGIC, sizeof(MANIFEST_MAGIC));
+    header.version = MANIFEST_VERSION;
+    header.branch_count = size();
+    header.block_count = static_cast<uint32_t>(owners.size());
+    header.checksum = fnv1a(owners.data(), owners.size() * sizeof(uint16_t),
+                            fnv1a(branches.data(), branches.size() * sizeof(BranchEntry)));
+
+    const std::string tempName = processTempName(fileName);
+    std::ofstream file(tempName, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(ManifestHeader));
+    file.write(reinterpret_cast<const char*>(branches.data()), branches.size() * sizeof(BranchEntry));
+    file.write(reinterpret_cast<const char*>(owners.data()), owners.size() * sizeof(uint16_t));
+    file.close();
+    return replaceFile(tempName, fileName, file && syncFile(tempName));
+}
+
+long BranchManifest::find(const std::string& name) const {
+    for (uint32_t i = 0; i < size(); i++) {
+        if (this->name(i) == name) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+uint32_t BranchManifest::blocksOwned(uint32_t branch) const {
+    return static_cast<uint32_t>(std::count(owners.begin(), owners.end(), branch));
+}
+
+long BranchManifest::ownerOf(int code) {
+    if (code < 1) {
+        return -1;
+    }
+    size_t block = static_cast<size_t>(code - 1) / CODE_BLOCK_SIZE;
+    std::lock_guard<std::mutex> guard(mutex);
+    if (block >= owners.size()) {
+        load();     // Leased by another process since this one loaded it
+    }
+    return block < owners.size() ? owners[block] : -1;
+}
+
+bool BranchManifest::addBranch(const std::string& name, const std::string& base, int highestCode) {
+    std::lock_guard<std::mutex> guard(mutex);
+    LockGuard writer(locks, WRITER_LOCK, true);
+    if (!writer.locked() || (exists() && !load())) {
+        return false;
+    }
+    if (find(name) >= 0 || size() >= MAX_BRANCHES) {
+        return false;
+    }
+    BranchEntry entry;
+    copyField(entry.name, sizeof(entry.name), name);
+    copyField(entry.base, sizeof(entry.base), base);
+    branches.push_back(entry);
+    for (int code = 1; code <= highestCode; code += CODE_BLOCK_SIZE) {
+        size_t block = static_cast<size_t>(code - 1) / CODE_BLOCK_SIZE;
+        if (block >= owners.size()) {
+            owners.push_back(static_cast<uint16_t>(size() - 1));
+        }
+    }
+    return save();
+}
+
+// A code that does not end a block is followed by the next code of the same
+// block, which belongs to the branch that issued it; only the first code of
+// a block needs the manifest lock and a write.
+int BranchManifest::nextCode(uint32_t branch, int lastCode, bool lease) {
+    if (lastCode > 0 && lastCode % CODE_BLOCK_SIZE != 0) {
+        return lastCode + 1;
+    }
+    std::lock_guard<std::mutex> guard(mutex);
+    if (!lease) {
+        load();
+        return static_cast<int>(owners.size()) * CODE_BLOCK_SIZE + 1;
+    }
+    LockGuard writer(locks, WRITER_LOCK, true);
+    if (!writer.locked() || !load() ||
+        owners.size() >= static_cast<size_t>(std::numeric_limits<int>::max() / CODE_BLOCK_SIZE)) {
+        return 0;
+    }
+    owners.push_back(static_cast<uint16_t>(branch));
+    if (!save()) {
+        owners.pop_back();
+        return 0;
+    }
+    return static_cast<int>(owners.size() - 1) * CODE_BLOCK_SIZE + 1;
+}
+
+// Merges runs that are each sorted by code: take(run, i) is called for every
+// element in overall code order, and codeOf(run, i) gives an element's code.
+template <typename CodeOf, typename Take>
+void mergeByCode(const std::vector<size_t>& runSizes, CodeOf codeOf, Take take) {
+    using Head = std::pair<int, size_t>;       // Code, run
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+    std::vector<size_t> next(runSizes.size(), 0);
+    for (size_t run = 0; run < runSizes.size(); run++) {
+        if (runSizes[run] > 0) heads.push({codeOf(run, 0), run});
+    }
+    while (!heads.empty()) {
+        size_t run = heads.top().second;
+        heads.pop();
+        take(run, next[run]);
+        if (++next[run] < runSizes[run]) heads.push({codeOf(run, next[run]), run});
+    }
+}
+
+void Employee::display() const {
+    ReportBuffer out(std::cout);
+    display(out);
+}
+
+void Employee::display(ReportBuffer& out) const {
+    out.ch('-', 80).endLine();
+    out.text("Employee Code  : ").text(toText(code)).endLine();
+    out.text("Name           : ").text(name).endLine();
+    out.text("Address        : ").text(address).endLine();
+    out.text("Phone          : ").text(phone).endLine();
+    out.text("Joining Date   : ").text(dateText(dd, mm, yy)).endLine();
+    out.text("Designation    : ").text(designation).endLine();
+    out.text("Grade          : ").ch(grade).endLine();
+    
+    if (!isDailyGrade(grade)) {
+        out.text("House Allowance: ").ch(house_allowance).endLine();
+        out.text("Travel Allow.  : ").ch(travel_allowance).endLine();
+        out.text("Basic Salary   : $").text(toText(basic_salary)).endLine();
+    }
+    out.text("Loan Amount    : $").text(toText(loan)).endLine();
+    out.ch('-', 80).endLine();
+}
+
+void displayListHeader(ReportBuffer& out) {
+    out.left("CODE", 6)
+       .left("NAME", 20)
+       .left("PHONE", 12)
+       .left("DOJ", 12)
+       .left("DESIGNATION", 15)
+       .left("GRADE", 6)
+       .left("SALARY", 10).endLine();
+    out.ch('-', 80).endLine();
+}
+
+void displayForList(const EmployeeRecord& rec, ReportBuffer& out) {
+    out.left(toText(rec.code), 6)
+       .left(fieldView(rec.name, NAME_WIDTH).substr(0, 19), 20)
+       .left(fieldView(rec.phone, PHONE_WIDTH).substr(0, 11), 12)
+       .left(dateText(rec.dd, rec.mm, rec.yy), 12)
+       .left(fieldView(rec.designation, DESIGNATION_WIDTH).substr(0, 14), 15)
+       .left(std::string_view(&rec.grade, 1), 6);
+    
+    if (!isDailyGrade(rec.grade)) {
+        out.ch('$').left(toText(Money(rec.basic_salary).wholeDollars()), 9);
+    } else {
+        out.left("-", 10);
+    }
+    out.endLine();
+}
+
+// Salary calculation
+struct SalaryBreakdown {
+    Money basic;
+    Money hra;
+    Money ca;
+    Money da;
+    Money ot;
+    Money pf;
+    Money ld;
+    Money allowance;
+    Money deduction;
+    Money net;
+};
+
+// Salary rules, one per grade. Grades A-D are salaried: allowances and the
+// provident fund are percentages of the basic salary. Grade E is paid by the
+// day and hour from the timesheet. Every grade repays a percentage of its
+// loan each month. The built-in table can be replaced from SALARY_RULES.CSV,
+// read before the first employee is paid; the pay basis of each grade is fixed.
+const int GRADE_COUNT = 5;
+
+struct GradeRule {
+    int hra;                    // Percent of basic salary, when the employee has it
+    int ca;                     // Percent of basic salary, when the employee has it
+    int da;                     // Percent of basic salary
+    int pf;                     // Percent of basic salary
+    int loan;                   // Percent of the outstanding loan
+    int64_t dailyRate;          // Cents per day worked
+    int64_t overtimeRate;       // Cents per overtime hour
+};
+
+// Percentages are capped at 100 and rates at MAX_AMOUNT, which keeps every
+// product in the vector kernel within 32 x 32-bit multiplies. A salaried
+// grade has no day or overtime rate and a daily grade no percentage of a
+// basic salary.
+constexpr bool isValidGradeRule(const GradeRule& rule, PayBasis basis) {
+    for (int pct : {rule.hra, rule.ca, rule.da, rule.pf, rule.loan}) {
+        if (pct < 0 || pct > 100) return false;
+    }
+    if (rule.dailyRate < 0 || rule.dailyRate > 5000000 || rule.overtimeRate < 0 || rule.overtimeRate > 5000000) {
+        return false;
+    }
+    return basis == PAY_DAILY ? rule.hra == 0 && rule.ca == 0 && rule.da == 0 && rule.pf == 0
+                              : rule.dailyRate == 0 && rule.overtimeRate == 0;
+}
+
+constexpr GradeRule DEFAULT_GRADE_RULES[GRADE_COUNT] = {
+    {5, 2, 5, 2, 15, 0, 0},
+    {5, 2, 5, 2, 15, 0, 0},
+    {5, 2, 5, 2, 15, 0, 0},
+    {5, 2, 5, 2, 15, 0, 0},
+    {0, 0, 0, 0, 15, 3000, 1000},
+};
+
+static_assert(isValidGradeRule(DEFAULT_GRADE_RULES[0], gradeBasis(0)) &&
+              isValidGradeRule(DEFAULT_GRADE_RULES[1], gradeBasis(1)) &&
+              isValidGradeRule(DEFAULT_GRADE_RULES[2], gradeBasis(2)) &&
+              isValidGradeRule(DEFAULT_GRADE_RULES[3], gradeBasis(3)) &&
+              isValidGradeRule(DEFAULT_GRADE_RULES[4], gradeBasis(4)),
+              "built-in salary rules out of range");
+
+// The rules in force; replaced only by gradeRulesReady() before any pay is
+// computed
+GradeRule gradeRules[GRADE_COUNT] = {
+    DEFAULT_GRADE_RULES[0], DEFAULT_GRADE_RULES[1], DEFAULT_GRADE_RULES[2],
+    DEFAULT_GRADE_RULES[3], DEFAULT_GRADE_RULES[4]};
+
+// Identifies the rules saved results were computed under
+uint32_t gradeRulesFingerprint() {
+    uint32_t hash = 2166136261u;
+    for (const GradeRule& rule : gradeRules) {
+        const int64_t values[7] = {rule.hra, rule.ca, rule.da, rule.pf, rule.loan, rule.dailyRate, rule.overtimeRate};
+        hash = fnv1a(values, sizeof(values), hash);
+    }
+    return hash;
+}
+
+// Salary and loan amounts used for pay, clamped to the range accepted at
+// input so a damaged record cannot produce out-of-range components.
+Money payrollAmount(Money amount) {
+    if (amount < Money(0)) return Money(0);
+    if (amount > MAX_AMOUNT) return MAX_AMOUNT;
+    return amount;
+}
+
+Money payrollAmount(int32_t cents) {
+    return payrollAmount(Money(cents));
+}
+
+// Applies the salary slip rules to an Employee or an EmployeeRecord. Each
+// percentage component is rounded to the cent on its own, then summed
+// exactly.
+template <typename Rec>
+SalaryBreakdown calculateSalary(const Rec& emp, int days, int hours) {
+    SalaryBreakdown pay;
+    int grade = gradeIndex(emp.grade);
+    const GradeRule& rule = gradeRules[grade];
+    Money salary = payrollAmount(emp.basic_salary);
+    Money loan = payrollAmount(emp.loan);
+
+    if (gradeBasis(grade) == PAY_DAILY) {
+        pay.basic = Money(rule.dailyRate) * days;
+        pay.ot = Money(rule.overtimeRate) * hours;
+    } else {
+        if (emp.house_allowance == 'Y') pay.hra = salary.percent(rule.hra);
+        if (emp.travel_allowance == 'Y') pay.ca = salary.percent(rule.ca);
+        pay.da = salary.percent(rule.da);
+        pay.pf = salary.percent(rule.pf);
+        pay.basic = salary;
+    }
+    pay.ld = loan.percent(rule.loan);
+
+    pay.allowance = pay.hra + pay.ca + pay.da + pay.ot;
+    pay.deduction = pay.pf + pay.ld;
+    pay.net = (pay.basic + pay.allowance) - pay.deduction;
+    return pay;
+}
+
+// Columnar salary kernel. The batch run gathers the payroll fields of a chunk
+// into PayrollColumns grouped by grade, then computes each group with the
+// calculator for its pay basis and the grade's rule, so the inner loops
+// carry no grade test and allowance flags become masks. Amounts are integer
+// cents, so every path gives exactly what calculateSalary() does.
+struct PayrollColumns {
+    // Inputs, in cents and already clamped by payrollAmount(). Rows
+    // group[g] up to group[g + 1] hold grade g.
+    std::vector<uint32_t> slot;
+    std::vector<int64_t> basicSalary;
+    std::vector<int64_t> loan;
+    std::vector<uint8_t> house;
+    std::vector<uint8_t> travel;
+    std::vector<int32_t> days;
+    std::vector<int32_t> hours;
+    size_t group[GRADE_COUNT + 1] = {};
+
+    // Grade of each pushed record, in push order
+    std::vector<uint8_t> order;
+    size_t fill[GRADE_COUNT] = {};
+
+    // Outputs, in cents
+    std::vector<int64_t> basic, hra, ca, da, ot, pf, ld, allowance, deduction, net;
+
+    size_t size() const { return slot.size(); }
+
+    // Makes room for the given number of records of each grade
+    void reset(const uint32_t (&counts)[GRADE_COUNT]) {
+        group[0] = 0;
+        for (int g = 0; g < GRADE_COUNT; g++) {
+            fill[g] = group[g];
+            group[g + 1] = group[g] + counts[g];
+        }
+        size_t total = group[GRADE_COUNT];
+        slot.resize(total); basicSalary.resize(total); loan.resize(total);
+        house.resize(total); travel.resize(total);
+        days.resize(total); hours.resize(total);
+        order.clear();
+    }
+
+    void push(uint32_t recSlot, const EmployeeRecord& rec, int dayCount, int hourCount) {
+        int g = gradeIndex(rec.grade);
+        size_t i = fill[g]++;
+        slot[i] = recSlot;
+        basicSalary[i] = payrollAmount(rec.basic_salary).cents;
+        loan[i] = payrollAmount(rec.loan).cents;
+        house[i] = rec.house_allowance == 'Y';
+        travel[i] = rec.travel_allowance == 'Y';
+        days[i] = dayCount;
+        hours[i] = hourCount;
+        order.push_back(static_cast<uint8_t>(g));
+    }
+
+    // Calls f with each record's row, in the order the records were pushed
+    template <typename F>
+    void forEachPushed(F f) const {
+        size_t next[GRADE_COUNT];
+        std::copy(group, group + GRADE_COUNT, next);
+        for (uint8_t g : order) {
+            f(next[g]++);
+        }
+    }
+
+    void resizeOutputs() {
+        for (auto* column : {&basic, &hra, &ca, &da, &ot, &pf, &ld, &allowance, &deduction, &net}) {
+            column->resize(size());
+        }
+    }
+
+    SalaryBreakdown breakdown(size_t i) const {
+        SalaryBreakdown pay;
+        pay.basic = Money(basic[i]); pay.hra = Money(hra[i]); pay.ca = Money(ca[i]);
+        pay.da = Money(da[i]); pay.ot = Money(ot[i]); pay.pf = Money(pf[i]); pay.ld = Money(ld[i]);
+        pay.allowance = Money(allowance[i]); pay.deduction = Money(deduction[i]); pay.net = Money(net[i]);
+        return pay;
+    }
+};
+
+#ifdef PAYROLL_HAVE_AVX2
+// Widens four 0/1 flag bytes into a 4 x 64-bit lane mask
+__attribute__((target("avx2")))
+static inline __m256i flagMask(const uint8_t* flags) {
+    int32_t packed;
+    std::memcpy(&packed, flags, sizeof(packed));
+    __m256i wide = _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(packed));
+    return _mm256_cmpgt_epi64(wide, _mm256_setzero_si256());
+}
+
+// (x * pct + 50) / 100 for 0 <= x * pct + 50 < 2^32, via the usual
+// multiply-by-reciprocal: x / 100 == (x * 0x51EB851F) >> 37.
+__attribute__((target("avx2")))
+static inline __m256i percentOf(__m256i cents, __m256i pct) {
+    const __m256i half = _mm256_set1_epi64x(50);
+    const __m256i reciprocal = _mm256_set1_epi64x(0x51EB851F);
+    __m256i scaled = _mm256_add_epi64(_mm256_mul_epu32(cents, pct), half);
+    return _mm256_srli_epi64(_mm256_mul_epu32(scaled, reciprocal), 37);
+}
+
+__attribute__((target("avx2")))
+static inline void storeColumn(std::vector<int64_t>& column, size_t i, __m256i values) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(&column[i]), values);
+}
+
+bool cpuHasAvx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+#endif
+
+static inline void finishRow(PayrollColumns& cols, size_t i) {
+    cols.allowance[i] = cols.hra[i] + cols.ca[i] + cols.da[i] + cols.ot[i];
+    cols.deduction[i] = cols.pf[i] + cols.ld[i];
+    cols.net[i] = (cols.basic[i] + cols.allowance[i]) - cols.deduction[i];
+}
+
+// One calculator per pay basis. scalar() computes rows [begin, end); avx2()
+// computes whole groups of four from begin and returns where it stopped.
+template <PayBasis Basis>
+struct GradeCalculator;
+
+template <>
+struct GradeCalculator<PAY_SALARIED> {
+    static void scalar(PayrollColumns& cols, size_t begin, size_t end, const GradeRule& rule) {
+        for (size_t i = begin; i < end; i++) {
+            int64_t salary = cols.basicSalary[i];
+            cols.basic[i] = salary;
+            cols.hra[i] = ((salary * rule.hra + 50) / 100) & -static_cast<int64_t>(cols.house[i]);
+            cols.ca[i] = ((salary * rule.ca + 50) / 100) & -static_cast<int64_t>(cols.travel[i]);
+            cols.da[i] = (salary * rule.da + 50) / 100;
+            cols.pf[i] = (salary * rule.pf + 50) / 100;
+            cols.ot[i] = 0;
+            cols.ld[i] = (cols.loan[i] * rule.loan + 50) / 100;
+            finishRow(cols, i);
+        }
+    }
+
+#ifdef PAYROLL_HAVE_AVX2
+    __attribute__((target("avx2")))
+    static size_t avx2(PayrollColumns& cols, size_t begin, size_t end, const GradeRule& rule) {
+        const __m256i hraPct = _mm256_set1_epi64x(rule.hra);
+        const __m256i caPct = _mm256_set1_epi64x(rule.ca);
+        const __m256i daPct = _mm256_set1_epi64x(rule.da);
+        const __m256i pfPct = _mm256_set1_epi64x(rule.pf);
+        const __m256i loanPct = _mm256_set1_epi64x(rule.loan);
+
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4) {
+            __m256i salary = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&cols.basicSalary[i]));
+            __m256i loan = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&cols.loan[i]));
+
+            __m256i hra = _mm256_and_si256(flagMask(&cols.house[i]), percentOf(salary, hraPct));
+            __m256i ca = _mm256_and_si256(flagMask(&cols.travel[i]), percentOf(salary, caPct));
+            __m256i da = percentOf(salary, daPct);
+            __m256i pf = percentOf(salary, pfPct);
+            __m256i ld = percentOf(loan, loanPct);
+
+            __m256i allowance = _mm256_add_epi64(_mm256_add_epi64(hra, ca), da);
+            __m256i deduction = _mm256_add_epi64(pf, ld);
+
+            storeColumn(cols.basic, i, salary);
+            storeColumn(cols.hra, i, hra);
+            storeColumn(cols.ca, i, ca);
+            storeColumn(cols.da, i, da);
+            storeColumn(cols.ot, i, _mm256_setzero_si256());
+            storeColumn(cols.pf, i, pf);
+            storeColumn(cols.ld, i, ld);
+            storeColumn(cols.allowance, i, allowance);
+            storeColumn(cols.deduction, i, deduction);
+            storeColumn(cols.net, i, _mm256_sub_epi64(_mm256_add_epi64(salary, allowance), deduction));
+        }
+        return i;
+    }
+#endif
+};
+
+template <>
+struct GradeCalculator<PAY_DAILY> {
+    static void scalar(PayrollColumns& cols, size_t begin, size_t end, const GradeRule& rule) {
+        for (size_t i = begin; i < end; i++) {
+            cols.basic[i] = cols.days[i] * rule.dailyRate;
+            cols.ot[i] = cols.hours[i] * rule.overtimeRate;
+            cols.hra[i] = cols.ca[i] = cols.da[i] = cols.pf[i] = 0;
+            cols.ld[i] = (cols.loan[i] * rule.loan + 50) / 100;
+            finishRow(cols, i);
+        }
+    }
+
+#ifdef PAYROLL_HAVE_AVX2
+    __attribute__((target("avx2")))
+    static size_t avx2(PayrollColumns& cols, size_t begin, size_t end, const GradeRule& rule) {
+        const __m256i dailyRate = _mm256_set1_epi64x(rule.dailyRate);
+        const __m256i overtimeRate = _mm256_set1_epi64x(rule.overtimeRate);
+        const __m256i loanPct = _mm256_set1_epi64x(rule.loan);
+        const __m256i zero = _mm256_setzero_si256();
+
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4) {
+            __m256i loan = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&cols.loan[i]));
+            __m256i days = _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&cols.days[i])));
+            __m256i hours = _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&cols.hours[i])));
+
+            __m256i basic = _mm256_mul_epu32(days, dailyRate);
+            __m256i ot = _mm256_mul_epu32(hours, overtimeRate);
+            __m256i ld = percentOf(loan, loanPct);
+
+            storeColumn(cols.basic, i, basic);
+            storeColumn(cols.hra, i, zero);
+            storeColumn(cols.ca, i, zero);
+            storeColumn(cols.da, i, zero);
+            storeColumn(cols.ot, i, ot);
+            storeColumn(cols.pf, i, zero);
+            storeColumn(cols.ld, i, ld);
+            storeColumn(cols.allowance, i, ot);
+            storeColumn(cols.deduction, i, ld);
+            storeColumn(cols.net, i, _mm256_sub_epi64(_mm256_add_epi64(basic, ot), ld));
+        }
+        return i;
+    }
+#endif
+};
+
+template <PayBasis Basis>
+void computeGroup(PayrollColumns& cols, size_t begin, size_t end, const GradeRule& rule, bool allowSimd) {
+    size_t done = begin;
+#ifdef PAYROLL_HAVE_AVX2
+    if (allowSimd && cpuHasAvx2()) {
+        done = GradeCalculator<Basis>::avx2(cols, begin, end, rule);
+    }
+#else
+    (void)allowSimd;
+#endif
+    GradeCalculator<Basis>::scalar(cols, done, end, rule);
+}
+
+// Dispatches once per grade group
+void computeSalaries(PayrollColumns& cols, bool allowSimd = true) {
+    cols.resizeOutputs();
+    for (int g = 0; g < GRADE_COUNT; g++) {
+        if (cols.group[g] == cols.group[g + 1]) continue;
+        if (gradeBasis(g) == PAY_DAILY) {
+            computeGroup<PAY_DAILY>(cols, cols.group[g], cols.group[g + 1], gradeRules[g], allowSimd);
+        } else {
+            computeGroup<PAY_SALARIED>(cols, cols.group[g], cols.group[g + 1], gradeRules[g], allowSimd);
+        }
+    }
+}
+
+// Checks the vector kernel and the scalar fallback against calculateSalary()
+// under the rules in force, on a synthetic batch covering every grade and
+// flag combination. Returns the number of mismatching records.
+size_t verifySalaryKernel(size_t count) {
+    std::vector<EmployeeRecord> records(count);
+    std::vector<int> days(count), hours(count);
+    uint32_t counts[GRADE_COUNT] = {};
+    uint32_t seed = 12345;
+    auto next = [&seed]() {
+        seed = seed * 1103515245u + 12345u;
+        return (seed >> 8) & 0xFFFFFF;
+    };
+
+    for (size_t i = 0; i < count; i++) {
+        EmployeeRecord& rec = records[i];
+        std::memset(&rec, 0, sizeof(rec));
+        rec.code = static_cast<int32_t>(i + 1);
+        rec.grade = static_cast<char>('A' + next() % 5);
+        rec.house_allowance = (next() & 1) ? 'Y' : 'N';
+        rec.travel_allowance = (next() & 1) ? 'Y' : 'N';
+        rec.basic_salary = static_cast<int32_t>(next() % (MAX_AMOUNT.cents + 1));
+        rec.loan = static_cast<int32_t>(next() % (MAX_AMOUNT.cents + 1));
+        days[i] = static_cast<int>(next() % 32);
+        hours[i] = static_cast<int>(next() % 200);
+        counts[gradeIndex(rec.grade)]++;
+    }
+
+    PayrollColumns simd, scalar;
+    simd.reset(counts);
+    scalar.reset(counts);
+    for (size_t i = 0; i < count; i++) {
+        simd.push(static_cast<uint32_t>(i), records[i], days[i], hours[i]);
+        scalar.push(static_cast<uint32_t>(i), records[i], days[i], hours[i]);
+    }
+    computeSalaries(simd, true);
+    computeSalaries(scalar, false);
+
+    size_t mismatches = 0;
+    scalar.forEachPushed([&](size_t row) {
+        size_t i = scalar.slot[row];
+        SalaryBreakdown expected = calculateSalary(records[i], days[i], hours[i]);
+        SalaryBreakdown a = simd.breakdown(row);
+        SalaryBreakdown b = scalar.breakdown(row);
+        if (std::memcmp(&a, &expected, sizeof(SalaryBreakdown)) != 0 ||
+            std::memcmp(&b, &expected, sizeof(SalaryBreakdown)) != 0) {
+            mismatches++;
+        }
+    });
+    return mismatches;
+}
+
+// Batch payroll run
+const std::string TIMESHEET_FILE_NAME = "TIMESHEET.CSV";
+const std::string REGISTER_FILE_NAME = "PAYROLL_REGISTER.CSV";
+
+struct TimesheetEntry {
+    int days = 0;
+    int hours = 0;
+};
+
+// Grade E attendance keyed by employee code
+typedef std::unordered_map<int, TimesheetEntry> Timesheet;
+
+struct PayrollResult {
+    uint32_t slot;
+    SalaryBreakdown pay;
+};
+
+struct PayrollTotals {
+    size_t employees = 0;
+    size_t missingTimesheets = 0;
+    Money gross;
+    Money allowances;
+    Money deductions;
+    Money net;
+
+    void add(const SalaryBreakdown& pay) {
+        employees++;
+        gross += pay.basic + pay.allowance;
+        allowances += pay.allowance;
+        deductions += pay.deduction;
+        net += pay.net;
+    }
+
+    void remove(const SalaryBreakdown& pay) {
+        employees--;
+        gross -= pay.basic + pay.allowance;
+        allowances -= pay.allowance;
+        deductions -= pay.deduction;
+        net -= pay.net;
+    }
+
+    void merge(const PayrollTotals& other) {
+        employees += other.employees;
+        missingTimesheets += other.missingTimesheets;
+        gross += other.gross;
+        allowances += other.allowances;
+        deductions += other.deductions;
+        net += other.net;
+    }
+};
+
+// Reads "code,days,hours" lines; blank lines and '#' comments are skipped.
+// Bad lines are reported in errors and left out rather than failing the load.
+bool loadTimesheet(const std::string& fileName, Timesheet& sheet, std::vector<std::string>& errors) {
+    std::ifstream file(fileName);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    std::string line;
+    int lineNo = 0;
+    while (std::getline(file, line)) {
+        lineNo++;
+        if (line.empty() || line[0] == '#' || line[0] == '\r') continue;
+
+        int code = 0, days = 0, hours = 0;
+        char extra = 0;
+        if (std::sscanf(line.c_str(), "%d,%d,%d%c", &code, &days, &hours, &extra) < 3 ||
+            (extra != 0 && extra != '\r')) {
+            if (lineNo == 1) continue; // Column header
+            errors.push_back("line " + std::to_string(lineNo) + ": expected code,days,hours");
+        } else if (days < 0 || days > 31) {
+            errors.push_back("line " + std::to_string(lineNo) + ": days must be 0-31");
+        } else if (hours < 0) {
+            errors.push_back("line " + std::to_string(lineNo) + ": overtime hours must be 0 or more");
+        } else {
+            sheet[code] = {days, hours};
+        }
+    }
+    return true;
+}
+
+// Slots per unit of work. Chunk boundaries do not depend on the thread
+// count, so the merged totals are bit-for-bit the same however many threads
+// ran them.
+const uint32_t PAYROLL_CHUNK_SIZE = 16384;
+
+unsigned resolveThreadCount(unsigned requested) {
+    if (requested > 0) return requested;
+    unsigned hardware = std::thread::hardware_concurrency();
+    return hardware > 0 ? hardware : 1;
+}
+
+void runPayrollChunk(const MappedRoster& roster, const Timesheet& sheet,
+                     uint32_t begin, uint32_t end, PayrollColumns& cols,
+                     std::vector<PayrollResult>& results, PayrollTotals& totals) {
+    uint32_t counts[GRADE_COUNT] = {};
+    for (uint32_t slot = begin; slot < end; slot++) {
+        const EmployeeRecord& rec = roster[slot];
+        counts[gradeIndex(rec.grade)] += !(rec.flags & RECORD_DELETED);
+    }
+    cols.reset(counts);
+    for (uint32_t slot = begin; slot < end; slot++) {
+        const EmployeeRecord& rec = roster[slot];
+        if (rec.flags & RECORD_DELETED) continue;
+
+        TimesheetEntry entry;
+        if (isDailyGrade(rec.grade)) {
+            auto it = sheet.find(rec.code);
+            if (it != sheet.end()) {
+                entry = it->second;
+            } else {
+                totals.missingTimesheets++;
+            }
+        }
+        cols.push(slot, rec, entry.days, entry.hours);
+    }
+
+    computeSalaries(cols);
+
+    results.reserve(results.size() + cols.size());
+    cols.forEachPushed([&](size_t i) {
+        results.push_back({cols.slot[i], cols.breakdown(i)});
+        totals.add(results.back().pay);
+    });
+}
+
+// Computes pay for every live record of the roster. Worker threads take
+// fixed-size chunks from a shared counter; each chunk has its own results
+// and totals, which are merged in chunk order so results stay in slot order.
+PayrollTotals runPayroll(const MappedRoster& roster, const Timesheet& sheet,
+                         std::vector<PayrollResult>& results, unsigned threads = 0) {
+    ScopedTimer timer(METRIC_SALARY);
+    countRecordsScanned(roster.size());
+    uint32_t chunkCount = (roster.size() + PAYROLL_CHUNK_SIZE - 1) / PAYROLL_CHUNK_SIZE;
+    std::vector<std::vector<PayrollResult>> chunkResults(chunkCount);
+    std::vector<PayrollTotals> chunkTotals(chunkCount);
+    std::atomic<uint32_t> nextChunk{0};
+
+    auto worker = [&]() {
+        PayrollColumns cols;
+        for (uint32_t chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++) {
+            uint32_t begin = chunk * PAYROLL_CHUNK_SIZE;
+            uint32_t end = std::min(roster.size(), begin + PAYROLL_CHUNK_SIZE);
+            runPayrollChunk(roster, sheet, begin, end, cols, chunkResults[chunk], chunkTotals[chunk]);
+        }
+    };
+
+    unsigned workerCount = std::min<unsigned>(resolveThreadCount(threads), std::max<uint32_t>(chunkCount, 1));
+    std::vector<std::thread> pool;
+    for (unsigned i = 1; i < workerCount; i++) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : pool) {
+        thread.join();
+    }
+
+    PayrollTotals totals;
+    results.clear();
+    results.reserve(roster.liveCount());
+    for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+        results.insert(results.end(), chunkResults[chunk].begin(), chunkResults[chunk].end());
+        totals.merge(chunkTotals[chunk]);
+    }
+    return totals;
+}
+
+// Writes one CSV row per employee followed by a totals row. Rows are
+// formatted into a large buffer and written in blocks.
+bool writePayrollRegister(const std::string& fileName, const MappedRoster& roster,
+                          const std::vector<PayrollResult>& results, const PayrollTotals& totals) {
+    ScopedTimer timer(METRIC_RENDER);
+    std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    std::string buffer;
+    buffer.reserve(1 << 20);
+    buffer += "CODE,NAME,DESIGNATION,GRADE,BASIC,HRA,CA,DA,OVERTIME,PF,LOAN_DEDUCTION,"
+              "ALLOWANCES,DEDUCTIONS,NET\n";
+
+    char row[320];
+    for (const auto& result : results) {
+        const EmployeeRecord& rec = roster[result.slot];
+        const SalaryBreakdown& pay = result.pay;
+        int len = std::snprintf(row, sizeof(row), "%d,", rec.code);
+        buffer.append(row, static_cast<size_t>(len));
+        appendCsvField(buffer, fieldView(rec.name, NAME_WIDTH));
+        buffer += ',';
+        appendCsvField(buffer, fieldView(rec.designation, DESIGNATION_WIDTH));
+        buffer += ',';
+        buffer += rec.grade;
+        for (Money amount : {pay.basic, pay.hra, pay.ca, pay.da, pay.ot,
+                             pay.pf, pay.ld, pay.allowance, pay.deduction, pay.net}) {
+            buffer += ',';
+            appendMoney(buffer, amount);
+        }
+        buffer += '\n';
+
+        if (buffer.size() >= (1 << 20) - sizeof(row)) {
+            file.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    }
+
+    int len = std::snprintf(row, sizeof(row), "TOTAL,%zu employees,,,", totals.employees);
+    buffer.append(row, static_cast<size_t>(len));
+    appendMoney(buffer, totals.gross - totals.allowances);
+    buffer += ",,,,,,,";
+    appendMoney(buffer, totals.allowances);
+    buffer += ',';
+    appendMoney(buffer, totals.deductions);
+    buffer += ',';
+    appendMoney(buffer, totals.net);
+    buffer += '\n';
+    file.write(buffer.data(), buffer.size());
+    file.close();
+    return static_cast<bool>(file);
+}
+
+// Saved payroll results (PAYROLL.RES): each employee's pay from the last
+// run in a table addressed by code, followed by the timesheet rows the run
+// used. The header holds the totals, the data file header the run saw and a
+// fingerprint of the salary rules. If the rules are unchanged and the change
+// list still starts from that header, the next run only
+// recomputes the employees on it plus those whose timesheet row changed,
+// and patches the totals. Entries are patched in place between marking the
+// header incomplete and writing it back, so an interrupted run is never
+// trusted.
+const std::string PAYROLL_RESULTS_FILE_NAME = "PAYROLL.RES";
+const char RESULTS_MAGIC[4] = {'P', 'R', 'E', 'S'};
+const uint32_t RESULTS_VERSION = 2;
+
+const uint8_t RESULT_MISSING_TIMESHEET = 0x01;
+
+#pragma pack(push, 1)
+struct ResultsHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t complete;
+    uint32_t entry_count;       // Entry i holds code i + 1
+    uint32_t sheet_count;       // Timesheet rows after the table
+    uint32_t rules;             // gradeRulesFingerprint() of the run
+    FileHeader data;
+    int64_t employees;
+    int64_t missing_timesheets;
+    int64_t gross;
+    int64_t allowances;
+    int64_t deductions;
+    int64_t net;
+};
+
+struct ResultEntry {
+    int32_t code;               // 0 for a code with no live employee
+    uint8_t flags;
+    uint8_t reserved[3];
+    int64_t amounts[10];        // Basic, HRA, CA, DA, OT, PF, loan, allowances, deductions, net
+};
+
+struct TimesheetRow {
+    int32_t code;
+    int32_t days;
+    int32_t hours;
+};
+#pragma pack(pop)
+
+std::streamoff resultOffset(uint32_t index) {
+    return static_cast<std::streamoff>(sizeof(ResultsHeader)) +
+           static_cast<std::streamoff>(index) * sizeof(ResultEntry);
+}
+
+ResultEntry makeResultEntry(int32_t code, const SalaryBreakdown& pay, bool missingTimesheet) {
+    ResultEntry entry;
+    std::memset(&entry, 0, sizeof(entry));
+    entry.code = code;
+    entry.flags = missingTimesheet ? RESULT_MISSING_TIMESHEET : 0;
+    const Money amounts[10] = {pay.basic, pay.hra, pay.ca, pay.da, pay.ot,
+                               pay.pf, pay.ld, pay.allowance, pay.deduction, pay.net};
+    for (int i = 0; i < 10; i++) {
+        entry.amounts[i] = amounts[i].cents;
+    }
+    return entry;
+}
+
+SalaryBreakdown resultPay(const ResultEntry& entry) {
+    SalaryBreakdown pay;
+    Money* amounts[10] = {&pay.basic, &pay.hra, &pay.ca, &pay.da, &pay.ot,
+                          &pay.pf, &pay.ld, &pay.allowance, &pay.deduction, &pay.net};
+    for (int i = 0; i < 10; i++) {
+        *amounts[i] = Money(entry.amounts[i]);
+    }
+    return pay;
+}
+
+// Pay for one employee, as the batch kernel would compute it
+ResultEntry computeResult(const EmployeeRecord& rec, const Timesheet& sheet) {
+    TimesheetEntry hours;
+    bool missing = false;
+    if (isDailyGrade(rec.grade)) {
+        auto it = sheet.find(rec.code);
+        missing = it == sheet.end();
+        if (!missing) hours = it->second;
+    }
+    return makeResultEntry(rec.code, calculateSalary(rec, hours.days, hours.hours), missing);
+}
+
+// The timesheet rows for codes that have been handed out; rows for later
+// codes cannot belong to anyone yet and are not saved
+std::vector<TimesheetRow> sortedTimesheet(const Timesheet& sheet, int32_t lastCode) {
+    std::vector<TimesheetRow> rows;
+    rows.reserve(sheet.size());
+    for (const auto& entry : sheet) {
+        if (entry.first < 1 || entry.first > lastCode) continue;
+        rows.push_back({entry.first, entry.second.days, entry.second.hours});
+    }
+    std::sort(rows.begin(), rows.end(), [](const TimesheetRow& a, const TimesheetRow& b) { return a.code < b.code; });
+    return rows;
+}
+
+void storeTotals(ResultsHeader& header, const PayrollTotals& totals) {
+    header.employees = static_cast<int64_t>(totals.employees);
+    header.missing_timesheets = static_cast<int64_t>(totals.missingTimesheets);
+    header.gross = totals.gross.cents;
+    header.allowances = totals.allowances.cents;
+    header.deductions = totals.deductions.cents;
+    header.net = totals.net.cents;
+}
+
+PayrollTotals loadTotals(const ResultsHeader& header) {
+    PayrollTotals totals;
+    totals.employees = static_cast<size_t>(header.employees);
+    totals.missingTimesheets = static_cast<size_t>(header.missing_timesheets);
+    totals.gross = Money(header.gross);
+    totals.allowances = Money(header.allowances);
+    totals.deductions = Money(header.deductions);
+    totals.net = Money(header.net);
+    return totals;
+}
+
+// Whether the table and timesheet rows the header describes are all in the
+// file, checked before anything is allocated for them
+bool resultsFit(std::istream& file, const ResultsHeader& header) {
+    return static_cast<uint64_t>(header.entry_count) * sizeof(ResultEntry) +
+           static_cast<uint64_t>(header.sheet_count) * sizeof(TimesheetRow) <= bytesRemaining(file);
+}
+
+// Writes a complete results file from a full run
+bool saveResults(const std::string& fileName, const MappedRoster& roster, const Timesheet& sheet,
+                 const std::vector<PayrollResult>& results, const PayrollTotals& totals) {
+    ResultsHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, RESULTS_MAGIC, sizeof(RESULTS_MAGIC));
+    header.version = RESULTS_VERSION;
+    header.complete = 1;
+    header.rules = gradeRulesFingerprint();
+    header.data = roster.fileHeader();
+    header.entry_count = std::max(0, header.data.last_code);
+    storeTotals(header, totals);
+
+    std::vector<ResultEntry> table(header.entry_count);
+    std::memset(table.data(), 0, table.size() * sizeof(ResultEntry));
+    for (const auto& result : results) {
+        const EmployeeRecord& rec = roster[result.slot];
+        if (rec.code < 1 || static_cast<uint32_t>(rec.code) > header.entry_count) {
+            continue;
+        }
+        bool missing = isDailyGrade(rec.grade) && sheet.find(rec.code) == sheet.end();
+        table[rec.code - 1] = makeResultEntry(rec.code, result.pay, missing);
+    }
+    std::vector<TimesheetRow> rows = sortedTimesheet(sheet, header.data.last_code);
+    header.sheet_count = static_cast<uint32_t>(rows.size());
+
+    const std::string tempName = processTempName(fileName);
+    std::ofstream file(tempName, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(ResultsHeader));
+    file.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(ResultEntry));
+    file.write(reinterpret_cast<const char*>(rows.data()), rows.size() * sizeof(TimesheetRow));
+    file.close();
+    return replaceFile(tempName, fileName, static_cast<bool>(file));
+}
+
+// Patches the saved results for the employees changed since the last run.
+// Returns false, leaving the file as it was, when the saved results cannot
+// be used or so many employees changed that a full run is cheaper.
+bool patchResults(const std::string& fileName, EmployeeStore& store, const MappedRoster& roster,
+                  const Timesheet& sheet, PayrollTotals& totals, size_t& recomputed) {
+    ScopedTimer timer(METRIC_SALARY);
+    std::fstream file(fileName, std::ios::binary | std::ios::in | std::ios::out);
+    ResultsHeader header;
+    FileHeader base;
+    std::vector<int32_t> dirty;
+    if (!file.is_open() || !file.read(reinterpret_cast<char*>(&header), sizeof(ResultsHeader)) ||
+        std::memcmp(header.magic, RESULTS_MAGIC, sizeof(RESULTS_MAGIC)) != 0 ||
+        header.version != RESULTS_VERSION || header.complete != 1 || header.rules != gradeRulesFingerprint() ||
+        !resultsFit(file, header) ||
+        !store.readChanges(base, dirty, std::max<size_t>(roster.liveCount(), 64)) ||
+        std::memcmp(&base, &header.data, sizeof(FileHeader)) != 0) {
+        return false;
+    }
+
+    // Employees whose timesheet row was added, changed or removed
+    std::vector<TimesheetRow> previous(header.sheet_count);
+    file.seekg(resultOffset(header.entry_count), std::ios::beg);
+    if (!file.read(reinterpret_cast<char*>(previous.data()), previous.size() * sizeof(TimesheetRow))) {
+        return false;
+    }
+    std::vector<TimesheetRow> current = sortedTimesheet(sheet, roster.fileHeader().last_code);
+    size_t p = 0, c = 0;
+    while (p < previous.size() || c < current.size()) {
+        if (c == current.size() || (p < previous.size() && previous[p].code < current[c].code)) {
+            dirty.push_back(previous[p++].code);
+        } else if (p == previous.size() || current[c].code < previous[p].code) {
+            dirty.push_back(current[c++].code);
+        } else {
+            if (previous[p].days != current[c].days || previous[p].hours != current[c].hours) {
+                dirty.push_back(current[c].code);
+            }
+            p++;
+            c++;
+        }
+    }
+    std::sort(dirty.begin(), dirty.end());
+    dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+    // Only codes with a saved entry to clear or a live employee to pay need
+    // patching; anything else would just grow the table
+    int32_t lastCode = roster.fileHeader().last_code;
+    dirty.erase(std::remove_if(dirty.begin(), dirty.end(), [&](int32_t code) {
+        return code < 1 || code > lastCode ||
+               (static_cast<uint32_t>(code) > header.entry_count && !store.findRecord(roster, code));
+    }), dirty.end());
+    if (dirty.size() * 8 > std::max<size_t>(roster.liveCount(), 64)) {
+        return false;
+    }
+
+    header.complete = 0;
+    file.seekp(0, std::ios::beg);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(ResultsHeader));
+
+    // New codes extend the table; the old timesheet rows there are cleared
+    uint32_t entryCount = std::max<uint32_t>(header.entry_count, dirty.empty() ? 0 : dirty.back());
+    if (entryCount > header.entry_count) {
+        std::vector<ResultEntry> blank(entryCount - header.entry_count);
+        std::memset(blank.data(), 0, blank.size() * sizeof(ResultEntry));
+        file.seekp(resultOffset(header.entry_count), std::ios::beg);
+        file.write(reinterpret_cast<const char*>(blank.data()), blank.size() * sizeof(ResultEntry));
+    }
+
+    totals = loadTotals(header);
+    for (int32_t code : dirty) {
+        ResultEntry entry;
+        std::memset(&entry, 0, sizeof(entry));
+        uint32_t index = static_cast<uint32_t>(code - 1);
+        file.seekg(resultOffset(index), std::ios::beg);
+        if (index < header.entry_count && !file.read(reinterpret_cast<char*>(&entry), sizeof(ResultEntry))) {
+            return false;
+        }
+        if (entry.code != 0) {
+            totals.remove(resultPay(entry));
+            if (entry.flags & RESULT_MISSING_TIMESHEET) totals.missingTimesheets--;
+        }
+
+        const EmployeeRecord* rec = store.findRecord(roster, code);
+        std::memset(&entry, 0, sizeof(entry));
+        if (rec) {
+            entry = computeResult(*rec, sheet);
+            totals.add(resultPay(entry));
+            if (entry.flags & RESULT_MISSING_TIMESHEET) totals.missingTimesheets++;
+        }
+        file.seekp(resultOffset(index), std::ios::beg);
+        file.write(reinterpret_cast<const char*>(&entry), sizeof(ResultEntry));
+    }
+
+    header.entry_count = entryCount;
+    header.sheet_count = static_cast<uint32_t>(current.size());
+    header.data = roster.fileHeader();
+    header.complete = 1;
+    storeTotals(header, totals);
+    file.seekp(resultOffset(entryCount), std::ios::beg);
+    file.write(reinterpret_cast<const char*>(current.data()), current.size() * sizeof(TimesheetRow));
+    file.seekp(0, std::ios::beg);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(ResultsHeader));
+    file.close();
+    recomputed = dirty.size();
+    return static_cast<bool>(file);
+}
+
+// Every employee's pay in slot order, read back from the saved table
+bool loadResults(const std::string& fileName, const MappedRoster& roster, const Timesheet& sheet,
+                 std::vector<PayrollResult>& results) {
+    std::ifstream file(fileName, std::ios::binary);
+    ResultsHeader header;
+    if (!file.is_open() || !file.read(reinterpret_cast<char*>(&header), sizeof(ResultsHeader)) ||
+        !resultsFit(file, header)) {
+        return false;
+    }
+    std::vector<ResultEntry> table(header.entry_count);
+    if (!file.read(reinterpret_cast<char*>(table.data()), table.size() * sizeof(ResultEntry))) {
+        return false;
+    }
+
+    results.clear();
+    results.reserve(roster.liveCount());
+    for (uint32_t slot = 0; slot < roster.size(); slot++) {
+        const EmployeeRecord& rec = roster[slot];
+        if (rec.flags & RECORD_DELETED) continue;
+        uint32_t index = static_cast<uint32_t>(rec.code - 1);
+        bool saved = rec.code >= 1 && index < table.size() && table[index].code == rec.code;
+        results.push_back({slot, resultPay(saved ? table[index] : computeResult(rec, sheet))});
+    }
+    return true;
+}
+
+// Payroll run that reuses the previous run's results where it can. The
+// caller holds the writer lock, so the roster, the change list and the
+// saved results all describe the same data file. A roster that is not the
+// file's current state (a service cache that has not caught up) is paid in
+// full and nothing is saved. results, if given, receives the register rows.
+PayrollTotals runSavedPayroll(EmployeeStore& store, const MappedRoster& roster, const Timesheet& sheet,
+                              bool full, unsigned threads, std::vector<PayrollResult>* results,
+                              size_t& recomputed, const std::string& resultsFile = PAYROLL_RESULTS_FILE_NAME) {
+    FileHeader current;
+    bool consistent = roster.isOpen() && store.readFileHeader(current) &&
+                      std::memcmp(&current, &roster.fileHeader(), sizeof(FileHeader)) == 0;
+
+    PayrollTotals totals;
+    if (!full && consistent && patchResults(resultsFile, store, roster, sheet, totals, recomputed)) {
+        store.resetChanges(current);
+        if (results && !loadResults(resultsFile, roster, sheet, *results)) {
+            runPayroll(roster, sheet, *results, threads);
+        }
+        return totals;
+    }
+
+    std::vector<PayrollResult> computed;
+    totals = runPayroll(roster, sheet, computed, threads);
+    recomputed = totals.employees;
+    if (consistent && saveResults(resultsFile, roster, sheet, computed, totals)) {
+        store.resetChanges(current);
+    }
+    if (results) {
+        *results = std::move(computed);
+    }
+    return totals;
+}
+
+// Checks that an incremental run only patches codes that exist: a timesheet
+// row for a code never handed out must not grow the saved results. Works on
+// a throwaway store beside the data file and removes it afterwards.
+bool verifySavedResults() {
+    const std::string base = processTempName("SELFTEST");
+    const std::string files[] = {base + ".DAT", base + ".IDX", base + ".ATX", base + ".JNL",
+                                 base + ".CHG", base + ".RES", base + ".DAT.LCK"};
+    bool passed = false;
+    {
+        EmployeeStore store(files[0], files[1], files[2], files[3], files[4]);
+        std::vector<Employee> batch(2);
+        for (Employee& emp : batch) {
+            emp.name = "SELF TEST";
+            emp.address = "-";
+            emp.phone = "-";
+            emp.dd = 1; emp.mm = 1; emp.yy = 2020;
+            emp.designation = "CLERK";
+            emp.grade = 'E';
+            emp.house_allowance = emp.travel_allowance = 'N';
+        }
+        Timesheet sheet;
+        sheet[1] = {20, 2};
+        size_t recomputed = 0;
+        auto fileSize = [&files]() {
+            std::ifstream file(files[5], std::ios::binary | std::ios::ate);
+            return file.is_open() ? static_cast<uint64_t>(file.tellg()) : 0;
+        };
+        if (store.open() && store.appendRecords(batch)) {
+            MappedRoster roster(files[0]);
+            runSavedPayroll(store, roster, sheet, true, 1, nullptr, recomputed, files[5]);
+            sheet[5000000] = {1, 1};
+            runSavedPayroll(store, roster, sheet, false, 1, nullptr, recomputed, files[5]);
+            uint64_t before = fileSize();
+            passed = recomputed == 0;
+            runSavedPayroll(store, roster, sheet, false, 1, nullptr, recomputed, files[5]);
+            passed = passed && fileSize() == before &&
+                     before == sizeof(ResultsHeader) + 2 * sizeof(ResultEntry) + sizeof(TimesheetRow);
+        }
+    }
+    for (const auto& file : files) {
+        std::remove(file.c_str());
+    }
+    return passed;
+}
+
+// CSV import and export
+const std::string EXPORT_FILE_NAME = "EMPLOYEES.CSV";
+const std::string IMPORT_ERRORS_FILE_NAME = "IMPORT_ERRORS.TXT";
+const size_t IMPORT_BATCH_SIZE = 8192;
+const size_t CSV_READ_BLOCK = 1 << 20;
+
+const char* const EMPLOYEE_CSV_HEADER =
+    "CODE,NAME,ADDRESS,PHONE,JOINING_DATE,DESIGNATION,GRADE,HOUSE_ALLOWANCE,"
+    "TRAVEL_ALLOWANCE,BASIC_SALARY,LOAN\n";
+
+// Splits one CSV line into fields, honouring quoted fields. Returns false
+// for an unterminated quote.
+bool splitCsvLine(std::string_view line, std::vector<std::string>& fields) {
+    fields.clear();
+    fields.emplace_back();
+    bool quoted = false;
+    for (size_t i = 0; i < line.size(); i++) {
+        char c = line[i];
+        if (quoted) {
+            if (c == '"' && i + 1 < line.size() && line[i + 1] == '"') {
+                fields.back() += '"';
+                i++;
+            } else if (c == '"') {
+                quoted = false;
+            } else {
+                fields.back() += c;
+            }
+        } else if (c == '"') {
+            quoted = true;
+        } else if (c == ',') {
+            fields.emplace_back();
+        } else if (c != '\r') {
+            fields.back() += c;
+        }
+    }
+    return !quoted;
+}
+
+// Salary rule file: one "grade,hra,ca,da,pf,loan,daily rate,overtime rate"
+// line per grade to change, percentages as whole numbers and rates in
+// dollars. Grades not listed keep their built-in rules. Blank lines and '#'
+// comments are skipped, as is a column header on the first line.
+const std::string GRADE_RULES_FILE_NAME = "SALARY_RULES.CSV";
+
+const char* parseGradeRule(const std::vector<std::string>& fields, int& grade, GradeRule& rule) {
+    if (fields.size() != 8) return "expected grade,hra,ca,da,pf,loan,daily rate,overtime rate";
+    char letter = fields[0].size() == 1 ? static_cast<char>(toupper(static_cast<unsigned char>(fields[0][0]))) : 0;
+    if (letter < 'A' || letter > 'E') {
+        return "grade must be A-E";
+    }
+    grade = letter - 'A';
+    int* percents[5] = {&rule.hra, &rule.ca, &rule.da, &rule.pf, &rule.loan};
+    for (int i = 0; i < 5; i++) {
+        const char* text = fields[i + 1].c_str();
+        char* end = nullptr;
+        errno = 0;
+        long value = std::strtol(text, &end, 10);
+        if (end == text || *end != '\0' || errno == ERANGE || value < 0 || value > 100) {
+            return "percentages must be whole numbers from 0 to 100";
+        }
+        *percents[i] = static_cast<int>(value);
+    }
+    Money daily, overtime;
+    if (!parseMoney(fields[6], daily) || !parseMoney(fields[7], overtime)) {
+        return "rates must be amounts in dollars";
+    }
+    rule.dailyRate = daily.cents;
+    rule.overtimeRate = overtime.cents;
+    if (!isValidGradeRule(rule, gradeBasis(grade))) {
+        return gradeBasis(grade) == PAY_DAILY
+                   ? "grade E is paid by the day: hra, ca, da and pf must be 0, loan 0-100, rates up to 50000"
+                   : "grades A-D are salaried: percentages must be 0-100 and both rates 0";
+    }
+    return nullptr;
+}
+
+// Replaces the rules in force from the file. A missing file leaves the
+// built-in rules; any bad line leaves them too and is reported in errors,
+// since paying with half a rule file is worse than refusing to start.
+bool loadGradeRules(const std::string& fileName, std::vector<std::string>& errors) {
+    std::ifstream file(fileName);
+    if (!file.is_open()) {
+        return true;
+    }
+
+    GradeRule rules[GRADE_COUNT];
+    std::copy(gradeRules, gradeRules + GRADE_COUNT, rules);
+    std::vector<std::string> fields;
+    std::string line;
+    int lineNo = 0;
+    bool firstRow = true;
+    while (std::getline(file, line)) {
+        lineNo++;
+        size_t start = line.find_first_not_of(" \t\r");
+        if (start == std::string::npos || line[start] == '#') continue;
+
+        int grade = 0;
+        GradeRule rule = {};
+        const char* error = splitCsvLine(line, fields) ? parseGradeRule(fields, grade, rule)
+                                                       : "unterminated quote";
+        bool header = firstRow && error && !fields.empty() && fields[0].size() > 1;
+        firstRow = false;
+        if (header) continue; // Column header
+        if (error) {
+            errors.push_back("line " + std::to_string(lineNo) + ": " + error);
+        } else {
+            rules[grade] = rule;
+        }
+    }
+    if (!errors.empty()) {
+        return false;
+    }
+    std::copy(rules, rules + GRADE_COUNT, gradeRules);
+    return true;
+}
+
+// Loads the rule file the first time anything is paid, so a bad file stops
+// only the commands that would pay with it. Errors are reported once.
+bool gradeRulesReady() {
+    static bool loaded = false;
+    static bool usable = false;
+    if (!loaded) {
+        loaded = true;
+        std::vector<std::string> errors;
+        usable = loadGradeRules(GRADE_RULES_FILE_NAME, errors);
+        for (const auto& error : errors) {
+            std::cerr << GRADE_RULES_FILE_NAME << " " << error << "\n";
+        }
+    }
+    return usable;
+}
+
+void printGradeRules(std::ostream& os) {
+    ReportBuffer out(os);
+    out.left("GRADE", 7).left("PAY", 10).right("HRA%", 6).right("CA%", 6).right("DA%", 6).right("PF%", 6)
+       .right("LOAN%", 7).right("DAILY", 12).right("OVERTIME", 12).endLine();
+    out.ch('-', 72).endLine();
+    for (int g = 0; g < GRADE_COUNT; g++) {
+        const GradeRule& rule = gradeRules[g];
+        out.left(std::string(1, static_cast<char>('A' + g)), 7)
+           .left(gradeBasis(g) == PAY_DAILY ? "daily" : "salary", 10)
+           .right(toText(rule.hra), 6).right(toText(rule.ca), 6).right(toText(rule.da), 6)
+           .right(toText(rule.pf), 6).right(toText(rule.loan), 7)
+           .right(toText(Money(rule.dailyRate)), 12).right(toText(Money(rule.overtimeRate)), 12).endLine();
+    }
+}
+
+// A grade typed as a single letter in either case; false unless it is A-E
+bool parseGrade(const std::string& text, char& grade) {
+    char letter = text.size() == 1 ? static_cast<char>(toupper(static_cast<unsigned char>(text[0]))) : 0;
+    if (letter < 'A' || letter > 'E') return false;
+    grade = letter;
+    return true;
+}
+
+bool isValidText(std::string& text, size_t maxLength) {
+    if (text.empty() || text.length() > maxLength) return false;
+    std::transform(text.begin(), text.end(), text.begin(), ::toupper);
+    return true;
+}
+
+// Applies the same rules as the interactive entry screens and normalises the
+// record the same way (upper-cased text, "-" for no phone, no allowances or
+// basic salary for grade E). Returns an error message, or nullptr if valid.
+const char* validateEmployee(Employee& emp) {
+    if (!isValidText(emp.name, NAME_WIDTH)) return "name must be 1-25 characters";
+    if (!isValidText(emp.address, ADDRESS_WIDTH)) return "address must be 1-50 characters";
+    if (emp.phone.empty()) emp.phone = "-";
+    if (emp.phone.length() > static_cast<size_t>(PHONE_WIDTH)) return "phone must be at most 20 characters";
+    if (!isValidDate(emp.dd, emp.mm, emp.yy)) return "invalid joining date";
+    if (!isValidText(emp.designation, DESIGNATION_WIDTH)) return "designation must be 1-20 characters";
+
+    emp.grade = static_cast<char>(toupper(emp.grade));
+    if (emp.grade < 'A' || emp.grade > 'E') return "grade must be A, B, C, D or E";
+
+    if (isDailyGrade(emp.grade)) {
+        emp.house_allowance = '\0';
+        emp.travel_allowance = '\0';
+        emp.basic_salary = Money(0);
+    } else {
+        emp.house_allowance = static_cast<char>(toupper(emp.house_allowance));
+        emp.travel_allowance = static_cast<char>(toupper(emp.travel_allowance));
+        if (emp.house_allowance != 'Y' && emp.house_allowance != 'N') return "house allowance must be Y or N";
+        if (emp.travel_allowance != 'Y' && emp.travel_allowance != 'N') return "travel allowance must be Y or N";
+        if (!isValidAmount(emp.basic_salary)) return "basic salary must be between 0 and 50000";
+    }
+    if (!isValidAmount(emp.loan)) return "loan must be between 0 and 50000";
+    return nullptr;
+}
+
+// Parses a "d/m/yyyy" date; range checks are left to isValidDate().
+bool parseDate(const std::string& text, int& d, int& m, int& y) {
+    char extra = 0;
+    return std::sscanf(text.c_str(), "%d/%d/%d%c", &d, &m, &y, &extra) == 3;
+}
+
+// Builds an Employee from the CSV columns in EMPLOYEE_CSV_HEADER order. The
+// CODE column is ignored; imported staff always receive fresh codes.
+const char* parseEmployeeRow(const std::vector<std::string>& fields, Employee& emp) {
+    if (fields.size() != 11) return "expected 11 columns";
+
+    emp = Employee();
+    emp.name = fields[1];
+    emp.address = fields[2];
+    emp.phone = fields[3];
+    if (!parseDate(fields[4], emp.dd, emp.mm, emp.yy)) {
+        return "joining date must be d/m/yyyy";
+    }
+    emp.designation = fields[5];
+    if (fields[6].size() != 1) return "grade must be A, B, C, D or E";
+    emp.grade = fields[6][0];
+
+    bool gradeE = isDailyGrade(static_cast<char>(toupper(static_cast<unsigned char>(emp.grade))));
+    if (!gradeE) {
+        if (fields[7].size() != 1 || fields[8].size() != 1) return "allowance flags must be Y or N";
+        emp.house_allowance = fields[7][0];
+        emp.travel_allowance = fields[8][0];
+        if (!parseMoney(fields[9], emp.basic_salary)) return "basic salary is not a number";
+    }
+    if (!parseMoney(fields[10].empty() ? "0" : fields[10], emp.loan)) return "loan is not a number";
+
+    return validateEmployee(emp);
+}
+
+struct ImportSummary {
+    size_t rows = 0;
+    size_t imported = 0;
+    size_t rejected = 0;
+    bool writeFailed = false;
+};
+
+// Streams a CSV file through a fixed-size read buffer, validating each row
+// and appending accepted employees to the store in batches under one group
+// commit. Rejected rows are written to errorLog as "line N: reason" and do
+// not stop the import.
+bool importEmployeesCsv(const std::string& fileName, EmployeeStore& store,
+                        std::ostream& errorLog, ImportSummary& summary) {
+    std::ifstream file(fileName, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    if (!store.beginGroup()) {
+        summary.writeFailed = true;
+        return true;
+    }
+    std::vector<Employee> batch;
+    batch.reserve(IMPORT_BATCH_SIZE);
+    std::vector<std::string> fields;
+    std::vector<char> block(CSV_READ_BLOCK);
+    std::string pending;
+    size_t lineNo = 0;
+
+    auto flushBatch = [&]() {
+        if (batch.empty() || summary.writeFailed) return;
+        if (store.appendRecords(batch)) {
+            summary.imported += batch.size();
+        } else {
+            summary.writeFailed = true;
+        }
+        batch.clear();
+    };
+
+    auto handleLine = [&](std::string_view line) {
+        lineNo++;
+        if (line.empty() || line == "\r") return;
+        if (lineNo == 1 && line.substr(0, 4) == "CODE") return;
+
+        summary.rows++;
+        Employee emp;
+        const char* error = splitCsvLine(line, fields) ? parseEmployeeRow(fields, emp)
+                                                       : "unterminated quoted field";
+        if (error) {
+            summary.rejected++;
+            errorLog << "line " << lineNo << ": " << error << "\n";
+            return;
+        }
+
+        batch.push_back(std::move(emp));
+        if (batch.size() >= IMPORT_BATCH_SIZE) {
+            flushBatch();
+        }
+    };
+
+    while (file.read(block.data(), block.size()) || file.gcount() > 0) {
+        std::string_view data(block.data(), static_cast<size_t>(file.gcount()));
+        size_t start = 0;
+        for (size_t newline = data.find('\n'); newline != std::string_view::npos;
+             newline = data.find('\n', start)) {
+            if (pending.empty()) {
+                handleLine(data.substr(start, newline - start));
+            } else {
+                pending.append(data.substr(start, newline - start));
+                handleLine(pending);
+                pending.clear();
+            }
+            start = newline + 1;
+        }
+        pending.append(data.substr(start));
+    }
+    if (!pending.empty()) {
+        handleLine(pending);
+    }
+    flushBatch();
+    if (!store.commitGroup()) {
+        summary.writeFailed = true;
+    }
+    return true;
+}
+
+// Writes every live record as CSV, formatting into a buffer that is written
+// in blocks so memory use does not grow with the roster.
+bool exportEmployeesCsv(const std::string& fileName, const MappedRoster& roster, size_t& exported) {
+    ScopedTimer timer(METRIC_RENDER);
+    countRecordsScanned(roster.size());
+    std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    exported = 0;
+    std::string buffer;
+    buffer.reserve(CSV_READ_BLOCK + 512);
+    buffer += EMPLOYEE_CSV_HEADER;
+
+    char text[64];
+    for (const auto& rec : roster) {
+        if (rec.flags & RECORD_DELETED) continue;
+
+        buffer.append(text, static_cast<size_t>(std::snprintf(text, sizeof(text), "%d,", rec.code)));
+        appendCsvField(buffer, fieldView(rec.name, NAME_WIDTH));
+        buffer += ',';
+        appendCsvField(buffer, fieldView(rec.address, ADDRESS_WIDTH));
+        buffer += ',';
+        appendCsvField(buffer, fieldView(rec.phone, PHONE_WIDTH));
+        buffer.append(text, static_cast<size_t>(std::snprintf(text, sizeof(text), ",%d/%d/%d,", rec.dd, rec.mm, rec.yy)));
+        appendCsvField(buffer, fieldView(rec.designation, DESIGNATION_WIDTH));
+        buffer += ',';
+        buffer += rec.grade;
+        buffer += ',';
+        if (!isDailyGrade(rec.grade)) {
+            buffer += rec.house_allowance;
+            buffer += ',';
+            buffer += rec.travel_allowance;
+            buffer += ',';
+            appendMoney(buffer, Money(rec.basic_salary));
+        } else {
+            buffer += ",,";
+        }
+        buffer += ',';
+        appendMoney(buffer, Money(rec.loan));
+        buffer += '\n';
+        exported++;
+
+        if (buffer.size() >= CSV_READ_BLOCK) {
+            file.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    }
+    file.write(buffer.data(), buffer.size());
+    file.close();
+    return static_cast<bool>(file);
+}
+
+// Salary slip layout, shared by the interactive screen and the command line
+const char* const MONTH_NAMES[] = {"January", "February", "March", "April", "May", "June",
+                                   "July", "August", "September", "October", "November", "December"};
+
+std::tm currentDate() {
+    time_t rawtime;
+    time(&rawtime);
+    return *localtime(&rawtime);
+}
+
+void printSlipHeading(ReportBuffer& out, std::string_view name, std::string_view designation,
+                      char grade, const std::tm& date) {
+    out.ch('=', 80).endLine();
+    out.right("SALARY SLIP", 45).endLine();
+    out.right(MONTH_NAMES[date.tm_mon], 35).text(", ").text(toText(date.tm_year + 1900)).endLine();
+    out.ch('=', 80).endLine();
+
+    out.endLine().text("Employee Name: ").text(name);
+    out.right("Date: ", 40).text(dateText(date.tm_mday, date.tm_mon + 1, date.tm_year + 1900)).endLine();
+    out.text("Designation  : ").text(designation);
+    out.right("Grade: ", 40).ch(grade).endLine();
+
+    out.ch('-', 80).endLine();
+}
+
+void printSlipBreakdown(ReportBuffer& out, char grade, const SalaryBreakdown& pay) {
+    auto line = [&out](const char* label, Money amount) {
+        out.text(label).text(": $").right(toText(amount), 10).endLine();
+    };
+    // Percentage components are labelled with the grade's rate
+    auto rated = [&out](const char* label, int pct, Money amount) {
+        char text[40];
+        std::snprintf(text, sizeof(text), "  %s (%d%%)", label, pct);
+        out.left(text, 32).text(": $").right(toText(amount), 10).endLine();
+    };
+    const GradeRule& rule = gradeRules[gradeIndex(grade)];
+
+    out.endLine().text("SALARY BREAKDOWN:").endLine();
+    out.ch('-', 80).endLine();
+    
+    line("Basic Salary                    ", pay.basic);
+    
+    out.endLine().text("ALLOWANCES:").endLine();
+    if (!isDailyGrade(grade)) {
+        rated("House Allowance", rule.hra, pay.hra);
+        rated("Travel Allowance", rule.ca, pay.ca);
+        rated("Dearness Allowance", rule.da, pay.da);
+    } else {
+        line("  Overtime                      ", pay.ot);
+    }
+    line("  Total Allowances              ", pay.allowance);
+
+    out.endLine().text("DEDUCTIONS:").endLine();
+    if (!isDailyGrade(grade)) {
+        rated("Provident Fund", rule.pf, pay.pf);
+    }
+    rated("Loan Deduction", rule.loan, pay.ld);
+    line("  Total Deductions              ", pay.deduction);
+
+    out.ch('=', 80).endLine();
+    line("NET SALARY                      ", pay.net);
+    out.ch('=', 80).endLine();
+
+    out.endLine().endLine().text("CASHIER").right("EMPLOYEE", 65).endLine();
+}
+
+// Bulk salary slips: one slip per page, separated by form feeds, so the file
+// can be sent straight to a printer or a text-to-PDF converter.
+const std::string SLIPS_FILE_NAME = "SALARY_SLIPS.TXT";
+
+// Limits bulk slips to one grade and/or one designation; unset matches all
+struct SlipFilter {
+    char grade = 0;
+    std::string designation;
+
+    bool matches(const EmployeeRecord& rec) const {
+        return (grade == 0 || rec.grade == grade) &&
+               (designation.empty() || fieldView(rec.designation, DESIGNATION_WIDTH) == designation);
+    }
+};
+
+// Slots per unit of slip rendering. A rendered chunk is about 8 MB of text,
+// which bounds memory at one chunk per worker whatever the roster size.
+const uint32_t SLIP_CHUNK_SIZE = 4096;
+
+// Computes pay for one chunk with the batch payroll engine and renders the
+// slips of the matching employees into text.
+void renderSlipChunk(const MappedRoster& roster, const Timesheet& sheet, const SlipFilter& filter,
+                     const std::tm& date, uint32_t begin, uint32_t end, PayrollColumns& cols,
+                     std::vector<PayrollResult>& results, std::ostream& text, PayrollTotals& printed) {
+    PayrollTotals chunkTotals;
+    results.clear();
+    runPayrollChunk(roster, sheet, begin, end, cols, results, chunkTotals);
+
+    ReportBuffer out(text);
+    for (const auto& result : results) {
+        const EmployeeRecord& rec = roster[result.slot];
+        if (!filter.matches(rec)) continue;
+
+        printSlipHeading(out, fieldView(rec.name, NAME_WIDTH), fieldView(rec.designation, DESIGNATION_WIDTH),
+                         rec.grade, date);
+        printSlipBreakdown(out, rec.grade, result.pay);
+        out.ch('\f');
+        printed.add(result.pay);
+        if (isDailyGrade(rec.grade) && sheet.find(rec.code) == sheet.end()) {
+            printed.missingTimesheets++;
+        }
+    }
+}
+
+// Writes the slips of every matching employee in slot order. Each round
+// renders one chunk per worker in parallel, then the chunks are appended to
+// the file in order, so memory stays flat and the output does not depend on
+// the thread count. printed receives the totals of the slips written.
+bool writeSalarySlips(const std::string& fileName, const MappedRoster& roster, const Timesheet& sheet,
+                      const SlipFilter& filter, PayrollTotals& printed, unsigned threads = 0) {
+    ScopedTimer timer(METRIC_RENDER);
+    countRecordsScanned(roster.size());
+    std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    std::tm date = currentDate();
+    uint32_t chunkCount = (roster.size() + SLIP_CHUNK_SIZE - 1) / SLIP_CHUNK_SIZE;
+    unsigned workerCount = std::min<unsigned>(resolveThreadCount(threads), std::max<uint32_t>(chunkCount, 1));
+    std::vector<std::stringstream> pages(workerCount);
+    std::vector<PayrollTotals> pageTotals(workerCount);
+    std::vector<PayrollColumns> columns(workerCount);
+    std::vector<std::vector<PayrollResult>> results(workerCount);
+
+    printed = PayrollTotals();
+    for (uint32_t first = 0; first < chunkCount && file; first += workerCount) {
+        uint32_t count = std::min<uint32_t>(workerCount, chunkCount - first);
+        auto render = [&](uint32_t i) {
+            uint32_t begin = (first + i) * SLIP_CHUNK_SIZE;
+            uint32_t end = std::min(roster.size(), begin + SLIP_CHUNK_SIZE);
+            pages[i].str(std::string());
+            pageTotals[i] = PayrollTotals();
+            renderSlipChunk(roster, sheet, filter, date, begin, end, columns[i], results[i], pages[i], pageTotals[i]);
+        };
+
+        std::vector<std::thread> pool;
+        for (uint32_t i = 1; i < count; i++) {
+            pool.emplace_back(render, i);
+        }
+        render(0);
+        for (auto& thread : pool) {
+            thread.join();
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+            if (pageTotals[i].employees > 0) {
+                file << pages[i].rdbuf();
+            }
+            printed.merge(pageTotals[i]);
+        }
+    }
+    file.close();
+    return static_cast<bool>(file);
+}
+
+// Payroll archive: one file per month (PAYROLL-yyyy-mm.ARC) holding every
+// slip of that month's run column by column. A directory after the header
+// gives each column's encoding and byte range, so a query reads only the
+// columns it needs. Codes are stored as deltas, grade and designation as
+// indexes into a per-column dictionary, and every integer column is packed
+// at the bit width of its range above the column minimum.
+const std::string ARCHIVE_PREFIX = "PAYROLL-";
+const char ARCHIVE_MAGIC[4] = {'P', 'A', 'R', 'C'};
+const uint32_t ARCHIVE_VERSION = 1;
+
+const uint8_t ENCODING_PACKED = 1;
+const uint8_t ENCODING_DELTA = 2;
+const uint8_t ENCODING_DICTIONARY = 3;
+
+const size_t ARCHIVE_NAME_WIDTH = 16;
+
+#pragma pack(push, 1)
+struct ArchiveHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t row_count;
+    uint32_t column_count;
+    uint16_t year;
+    uint8_t month;
+    uint8_t reserved[5];
+};
+
+struct ArchiveColumn {
+    char name[ARCHIVE_NAME_WIDTH];
+    uint8_t encoding;
+    uint8_t width;              // Bits per packed value
+    uint16_t reserved;
+    uint32_t dictionary_count;  // Dictionary strings ahead of the packed indexes
+    int64_t base;               // Added to every packed value
+    uint64_t offset;
+    uint64_t length;
+};
+#pragma pack(pop)
+
+// Amount columns in SalaryBreakdown order
+const char* const ARCHIVE_AMOUNTS[] = {"basic", "hra", "ca", "da", "ot", "pf", "loan",
+                                       "allowances", "deductions", "net"};
+
+std::string archiveFileName(int year, int month) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%04d-%02d.ARC", year, month);
+    return ARCHIVE_PREFIX + name;
+}
+
+// Packs values - base into width bits each, least significant bit first
+void packValues(const std::vector<int64_t>& values, int64_t base, uint8_t width, std::string& out) {
+    size_t start = out.size();
+    out.resize(start + (values.size() * width + 7) / 8, '\0');
+    unsigned char* bytes = reinterpret_cast<unsigned char*>(&out[start]);
+    uint64_t bit = 0;
+    for (int64_t value : values) {
+        uint64_t packed = static_cast<uint64_t>(value - base);
+        for (uint8_t done = 0; done < width;) {
+            uint8_t shift = static_cast<uint8_t>(bit % 8);
+            uint8_t take = static_cast<uint8_t>(std::min<int>(8 - shift, width - done));
+            bytes[bit / 8] |= static_cast<unsigned char>(((packed >> done) & ((1u << take) - 1)) << shift);
+            done = static_cast<uint8_t>(done + take);
+            bit += take;
+        }
+    }
+}
+
+void unpackValues(const unsigned char* bytes, size_t count, int64_t base, uint8_t width, std::vector<int64_t>& values) {
+    values.resize(count);
+    uint64_t bit = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint64_t packed = 0;
+        for (uint8_t done = 0; done < width;) {
+            uint8_t shift = static_cast<uint8_t>(bit % 8);
+            uint8_t take = static_cast<uint8_t>(std::min<int>(8 - shift, width - done));
+            packed |= static_cast<uint64_t>((bytes[bit / 8] >> shift) & ((1u << take) - 1)) << done;
+            done = static_cast<uint8_t>(done + take);
+            bit += take;
+        }
+        values[i] = base + static_cast<int64_t>(packed);
+    }
+}
+
+uint8_t bitWidth(uint64_t range) {
+    uint8_t width = 0;
+    while (width < 64 && (range >> width) != 0) width++;
+    return width;
+}
+
+// Appends one integer column, frame-of-reference packed
+void addPackedColumn(std::vector<ArchiveColumn>& columns, std::string& data, const char* name,
+                     const std::vector<int64_t>& values, uint8_t encoding = ENCODING_PACKED) {
+    ArchiveColumn column;
+    std::memset(&column, 0, sizeof(column));
+    copyField(column.name, ARCHIVE_NAME_WIDTH, name);
+    column.encoding = encoding;
+    if (!values.empty()) {
+        auto range = std::minmax_element(values.begin(), values.end());
+        column.base = *range.first;
+        column.width = bitWidth(static_cast<uint64_t>(*range.second - *range.first));
+    }
+    column.offset = data.size();
+    packValues(values, column.base, column.width, data);
+    column.length = data.size() - column.offset;
+    columns.push_back(column);
+}
+
+// Appends one text column as a dictionary followed by packed indexes
+void addDictionaryColumn(std::vector<ArchiveColumn>& columns, std::string& data, const char* name,
+                         const std::vector<std::string_view>& values) {
+    std::unordered_map<std::string_view, int64_t> ids;
+    std::vector<std::string_view> dictionary;
+    std::vector<int64_t> indexes;
+    indexes.reserve(values.size());
+    for (std::string_view value : values) {
+        auto found = ids.emplace(value, static_cast<int64_t>(dictionary.size()));
+        if (found.second) dictionary.push_back(value);
+        indexes.push_back(found.first->second);
+    }
+
+    size_t offset = data.size();
+    for (std::string_view entry : dictionary) {
+        uint32_t length = static_cast<uint32_t>(entry.size());
+        data.append(reinterpret_cast<const char*>(&length), sizeof(length));
+        data.append(entry.data(), entry.size());
+    }
+    std::string packed;
+    std::vector<ArchiveColumn> single;
+    addPackedColumn(single, packed, name, indexes, ENCODING_DICTIONARY);
+    single[0].dictionary_count = static_cast<uint32_t>(dictionary.size());
+    single[0].offset = offset;
+    single[0].length = data.size() - offset + packed.size();
+    data += packed;
+    columns.push_back(single[0]);
+}
+
+// Writes the month's slips, one row per result, replacing any earlier run
+// archived for the same month
+bool writeArchive(const std::string& fileName, int year, int month, const MappedRoster& roster,
+                  const Timesheet& sheet, const std::vector<PayrollResult>& results) {
+    std::vector<int64_t> codes, days, hours;
+    std::vector<std::string_view> grades, designations;
+    std::vector<std::vector<int64_t>> amounts(10);
+    codes.reserve(results.size());
+    int64_t previous = 0;
+    for (const auto& result : results) {
+        const EmployeeRecord& rec = roster[result.slot];
+        codes.push_back(rec.code - previous);
+        previous = rec.code;
+        grades.push_back(std::string_view(&rec.grade, 1));
+        designations.push_back(fieldView(rec.designation, DESIGNATION_WIDTH));
+        TimesheetEntry entry;
+        if (isDailyGrade(rec.grade)) {
+            auto it = sheet.find(rec.code);
+            if (it != sheet.end()) entry = it->second;
+        }
+        days.push_back(entry.days);
+        hours.push_back(entry.hours);
+        const SalaryBreakdown& pay = result.pay;
+        const Money values[10] = {pay.basic, pay.hra, pay.ca, pay.da, pay.ot,
+                                  pay.pf, pay.ld, pay.allowance, pay.deduction, pay.net};
+        for (int i = 0; i < 10; i++) {
+            amounts[i].push_back(values[i].cents);
+        }
+    }
+
+    std::vector<ArchiveColumn> columns;
+    std::string data;
+    addPackedColumn(columns, data, "code", codes, ENCODING_DELTA);
+    addDictionaryColumn(columns, data, "grade", grades);
+    addDictionaryColumn(columns, data, "designation", designations);
+    addPackedColumn(columns, data, "days", days);
+    addPackedColumn(columns, data, "hours", hours);
+    for (int i = 0; i < 10; i++) {
+        addPackedColumn(columns, data, ARCHIVE_AMOUNTS[i], amounts[i]);
+    }
+
+    ArchiveHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+    header.version = ARCHIVE_VERSION;
+    header.row_count = static_cast<uint32_t>(results.size());
+    header.column_count = static_cast<uint32_t>(columns.size());
+    header.year = static_cast<uint16_t>(year);
+    header.month = static_cast<uint8_t>(month);
+    uint64_t dataStart = sizeof(ArchiveHeader) + columns.size() * sizeof(ArchiveColumn);
+    for (auto& column : columns) {
+        column.offset += dataStart;
+    }
+
+    const std::string tempName = processTempName(fileName);
+    std::ofstream file(tempName, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(ArchiveHeader));
+    file.write(reinterpret_cast<const char*>(columns.data()), columns.size() * sizeof(ArchiveColumn));
+    file.write(data.data(), static_cast<std::streamsize>(data.size()));
+    file.close();
+    return replaceFile(tempName, fileName, static_cast<bool>(file));
+}
+
+// Reads single columns of one month's archive on demand
+class ArchiveReader {
+public:
+    bool open(const std::string& fileName);
+    uint32_t rows() const { return header.row_count; }
+
+    // Integer columns; codes come back as codes, not deltas
+    bool readValues(const char* name, std::vector<int64_t>& values);
+    // Text columns: per-row indexes into dictionary
+    bool readText(const char* name, std::vector<int64_t>& indexes, std::vector<std::string>& dictionary);
+
+private:
+    std::ifstream file;
+    uint64_t fileSize = 0;
+    ArchiveHeader header{};
+    std::vector<ArchiveColumn> columns;
+
+    const ArchiveColumn* find(const char* name) const;
+    bool readBlock(const ArchiveColumn& column, std::vector<unsigned char>& bytes);
+};
+
+bool ArchiveReader::open(const std::string& fileName) {
+    file.open(fileName, std::ios::binary);
+    if (!file.is_open() || !file.read(reinterpret_cast<char*>(&header), sizeof(ArchiveHeader)) ||
+        std::memcmp(header.magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) != 0 || header.version != ARCHIVE_VERSION) {
+        return false;
+    }
+    fileSize = sizeof(ArchiveHeader) + bytesRemaining(file);
+    if (static_cast<uint64_t>(header.column_count) * sizeof(ArchiveColumn) > fileSize - sizeof(ArchiveHeader)) {
+        return false;
+    }
+    columns.resize(header.column_count);
+    return static_cast<bool>(file.read(reinterpret_cast<char*>(columns.data()), columns.size() * sizeof(ArchiveColumn)));
+}
+
+const ArchiveColumn* ArchiveReader::find(const char* name) const {
+    for (const auto& column : columns) {
+        if (std::strncmp(column.name, name, ARCHIVE_NAME_WIDTH) == 0) {
+            return &column;
+        }
+    }
+    return nullptr;
+}
+
+bool ArchiveReader::readBlock(const ArchiveColumn& column, std::vector<unsigned char>& bytes) {
+    if (column.offset > fileSize || column.length > fileSize - column.offset) {
+        return false;
+    }
+    bytes.resize(column.length);
+    file.clear();
+    file.seekg(static_cast<std::streamoff>(column.offset), std::ios::beg);
+    return static_cast<bool>(file.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size())));
+}
+
+bool ArchiveReader::readValues(const char* name, std::vector<int64_t>& values) {
+    const ArchiveColumn* column = find(name);
+    std::vector<unsigned char> bytes;
+    if (!column || column->encoding == ENCODING_DICTIONARY || !readBlock(*column, bytes) ||
+        bytes.size() < (static_cast<uint64_t>(header.row_count) * column->width + 7) / 8) {
+        return false;
+    }
+    unpackValues(bytes.data(), header.row_count, column->base, column->width, values);
+    if (column->encoding == ENCODING_DELTA) {
+        for (size_t i = 1; i < values.size(); i++) {
+            values[i] += values[i - 1];
+        }
+    }
+    return true;
+}
+
+bool ArchiveReader::readText(const char* name, std::vector<int64_t>& indexes, std::vector<std::string>& dictionary) {
+    const ArchiveColumn* column = find(name);
+    std::vector<unsigned char> bytes;
+    if (!column || column->encoding != ENCODING_DICTIONARY || !readBlock(*column, bytes)) {
+        return false;
+    }
+    dictionary.clear();
+    size_t pos = 0;
+    for (uint32_t i = 0; i < column->dictionary_count; i++) {
+        uint32_t length = 0;
+        if (pos + sizeof(length) > bytes.size()) return false;
+        std::memcpy(&length, bytes.data() + pos, sizeof(length));
+        pos += sizeof(length);
+        if (pos + length > bytes.size()) return false;
+        dictionary.emplace_back(reinterpret_cast<const char*>(bytes.data() + pos), length);
+        pos += length;
+    }
+    if (bytes.size() - pos < (static_cast<uint64_t>(header.row_count) * column->width + 7) / 8) {
+        return false;
+    }
+    unpackValues(bytes.data() + pos, header.row_count, column->base, column->width, indexes);
+    for (int64_t index : indexes) {
+        if (index < 0 || static_cast<uint64_t>(index) >= dictionary.size()) return false;
+    }
+    return true;
+}
+
+bool isArchiveColumn(const std::string& name) {
+    for (const char* amount : ARCHIVE_AMOUNTS) {
+        if (name == amount) return true;
+    }
+    return name == "days" || name == "hours";
+}
+
+// Parses "yyyy-mm"
+bool parseMonth(const std::string& text, int& year, int& month) {
+    char extra = 0;
+    return std::sscanf(text.c_str(), "%d-%d%c", &year, &month, &extra) == 2 &&
+           year >= 1900 && year <= 9999 && month >= 1 && month <= 12;
+}
+
+// Roster analytics. One parallel pass pays every employee with the batch
+// kernel, exactly as a payroll run would, and folds each slip into the
+// statistics of its grade, designation and joining year at once. Workers
+// take chunks from a shared counter and keep their own groups; designations
+// are keyed by views into the roster until the workers' groups are merged.
+enum Grouping {
+    GROUP_GRADE,
+    GROUP_DESIGNATION,
+    GROUP_YEAR,
+    GROUPING_COUNT
+};
+
+const char* const GROUPING_NAMES[GROUPING_COUNT] = {"grade", "designation", "year"};
+
+// The archive's amount columns plus the loans still outstanding
+const size_t ANALYTICS_AMOUNT_COUNT = std::size(ARCHIVE_AMOUNTS) + 1;
+const char* const LOAN_BALANCE_COLUMN = "loan-balance";
+
+struct GroupStats {
+    int64_t employees = 0;
+    Money sum[ANALYTICS_AMOUNT_COUNT];
+    Money min[ANALYTICS_AMOUNT_COUNT];
+    Money max[ANALYTICS_AMOUNT_COUNT];
+
+    void add(const SalaryBreakdown& pay, Money loanBalance) {
+        const Money amounts[ANALYTICS_AMOUNT_COUNT] = {pay.basic, pay.hra, pay.ca, pay.da, pay.ot, pay.pf, pay.ld,
+                                                       pay.allowance, pay.deduction, pay.net, loanBalance};
+        for (size_t i = 0; i < ANALYTICS_AMOUNT_COUNT; i++) {
+            sum[i] += amounts[i];
+            min[i] = employees == 0 || amounts[i] < min[i] ? amounts[i] : min[i];
+            max[i] = employees == 0 || amounts[i] > max[i] ? amounts[i] : max[i];
+        }
+        employees++;
+    }
+
+    void merge(const GroupStats& other) {
+        if (other.employees == 0) return;
+        for (size_t i = 0; i < ANALYTICS_AMOUNT_COUNT; i++) {
+            sum[i] += other.sum[i];
+            min[i] = employees == 0 || other.min[i] < min[i] ? other.min[i] : min[i];
+            max[i] = employees == 0 || other.max[i] > max[i] ? other.max[i] : max[i];
+        }
+        employees += other.employees;
+    }
+
+    // Rounded to the nearest cent, halves away from zero
+    Money average(size_t amount) const {
+        if (employees == 0) return Money();
+        int64_t total = sum[amount].cents;
+        return Money((total + (total < 0 ? -employees : employees) / 2) / employees);
+    }
+};
+
+struct RosterAnalytics {
+    GroupStats all;
+    std::map<std::string, GroupStats> groups[GROUPING_COUNT];
+    size_t missingTimesheets = 0;
+};
+
+// Index of an amount column by name, or -1
+int analyticsAmount(const std::string& name) {
+    for (size_t i = 0; i < std::size(ARCHIVE_AMOUNTS); i++) {
+        if (name == ARCHIVE_AMOUNTS[i]) return static_cast<int>(i);
+    }
+    return name == LOAN_BALANCE_COLUMN ? static_cast<int>(ANALYTICS_AMOUNT_COUNT) - 1 : -1;
+}
+
+RosterAnalytics analyseRoster(const MappedRoster& roster, const Timesheet& sheet, unsigned threads = 0) {
+    ScopedTimer timer(METRIC_SALARY);
+    countRecordsScanned(roster.size());
+
+    struct WorkerGroups {
+        GroupStats all;
+        GroupStats grades['E' - 'A' + 1];
+        std::unordered_map<std::string_view, GroupStats> designations;
+        std::map<int, GroupStats> years;
+        size_t missingTimesheets = 0;
+    };
+
+    uint32_t chunkCount = (roster.size() + PAYROLL_CHUNK_SIZE - 1) / PAYROLL_CHUNK_SIZE;
+    unsigned workerCount = std::min<unsigned>(resolveThreadCount(threads), std::max<uint32_t>(chunkCount, 1));
+    std::vector<WorkerGroups> workers(workerCount);
+    std::atomic<uint32_t> nextChunk{0};
+
+    auto work = [&](WorkerGroups& groups) {
+        PayrollColumns cols;
+        std::vector<PayrollResult> results;
+        for (uint32_t chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++) {
+            uint32_t begin = chunk * PAYROLL_CHUNK_SIZE;
+            uint32_t end = std::min(roster.size(), begin + PAYROLL_CHUNK_SIZE);
+            PayrollTotals totals;
+            results.clear();
+            runPayrollChunk(roster, sheet, begin, end, cols, results, totals);
+            groups.missingTimesheets += totals.missingTimesheets;
+
+            for (const auto& result : results) {
+                const EmployeeRecord& rec = roster[result.slot];
+                Money loan(rec.loan);
+                groups.all.add(result.pay, loan);
+                if (rec.grade >= 'A' && rec.grade <= 'E') {
+                    groups.grades[rec.grade - 'A'].add(result.pay, loan);
+                }
+                groups.designations[fieldView(rec.designation, DESIGNATION_WIDTH)].add(result.pay, loan);
+                groups.years[rec.yy].add(result.pay, loan);
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned i = 1; i < workerCount; i++) {
+        pool.emplace_back(work, std::ref(workers[i]));
+    }
+    work(workers[0]);
+    for (auto& thread : pool) {
+        thread.join();
+    }
+
+    RosterAnalytics analytics;
+    for (const auto& groups : workers) {
+        analytics.all.merge(groups.all);
+        analytics.missingTimesheets += groups.missingTimesheets;
+        for (char grade = 'A'; grade <= 'E'; grade++) {
+            if (groups.grades[grade - 'A'].employees > 0) {
+                analytics.groups[GROUP_GRADE][std::string(1, grade)].merge(groups.grades[grade - 'A']);
+            }
+        }
+        for (const auto& group : groups.designations) {
+            analytics.groups[GROUP_DESIGNATION][std::string(group.first)].merge(group.second);
+        }
+        for (const auto& group : groups.years) {
+            analytics.groups[GROUP_YEAR][std::to_string(group.first)].merge(group.second);
+        }
+    }
+    return analytics;
+}
+
+// One grouping as a table of the chosen amount's total, average, minimum
+// and maximum per group
+void printAnalytics(ReportBuffer& out, const RosterAnalytics& analytics, Grouping grouping, int amount) {
+    std::string heading = GROUPING_NAMES[grouping];
+    std::transform(heading.begin(), heading.end(), heading.begin(), ::toupper);
+    out.left(heading, 22).right("EMPLOYEES", 10).right("TOTAL", 18).right("AVERAGE", 14)
+       .right("MIN", 14).right("MAX", 14).endLine();
+    out.ch('-', 92).endLine();
+    auto row = [&out, amount](std::string_view name, const GroupStats& stats) {
+        out.left(name, 22).right(toText(stats.employees), 10).right(toText(stats.sum[amount]), 18)
+           .right(toText(stats.average(amount)), 14).right(toText(stats.min[amount]), 14)
+           .right(toText(stats.max[amount]), 14).endLine();
+    };
+    for (const auto& group : analytics.groups[grouping]) {
+        row(group.first, group.second);
+    }
+    out.ch('-', 92).endLine();
+    row("TOTAL", analytics.all);
+}
+
+// Every grouping and every amount, one row per group
+bool writeAnalyticsCsv(const std::string& fileName, const RosterAnalytics& analytics) {
+    std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::string buffer = "GROUPING,GROUP,EMPLOYEES";
+    for (size_t i = 0; i < ANALYTICS_AMOUNT_COUNT; i++) {
+        std::string name = i + 1 < ANALYTICS_AMOUNT_COUNT ? ARCHIVE_AMOUNTS[i] : LOAN_BALANCE_COLUMN;
+        std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+        std::replace(name.begin(), name.end(), '-', '_');
+        for (const char* statistic : {"_TOTAL", "_AVERAGE", "_MIN", "_MAX"}) {
+            buffer += ',';
+            buffer += name;
+            buffer += statistic;
+        }
+    }
+    buffer += '\n';
+
+    auto row = [&buffer](std::string_view grouping, std::string_view name, const GroupStats& stats) {
+        buffer.append(grouping);
+        buffer += ',';
+        appendCsvField(buffer, name);
+        buffer += ',';
+        buffer += std::to_string(stats.employees);
+        for (size_t i = 0; i < ANALYTICS_AMOUNT_COUNT; i++) {
+            for (Money value : {stats.sum[i], stats.average(i), stats.min[i], stats.max[i]}) {
+                buffer += ',';
+                appendMoney(buffer, value);
+            }
+        }
+        buffer += '\n';
+    };
+    for (int grouping = 0; grouping < GROUPING_COUNT; grouping++) {
+        for (const auto& group : analytics.groups[grouping]) {
+            row(GROUPING_NAMES[grouping], group.first, group.second);
+        }
+    }
+    row("all", "ALL", analytics.all);
+    file.write(buffer.data(), buffer.size());
+    return static_cast<bool>(file);
+}
+
+// Command-line arguments: positional words plus "--name value" or
+// "--name=value" options. An option followed by another option, or last,
+// is a flag with an empty value. The options in FLAG_OPTIONS never take a
+// value, so a positional word may follow them too.
+const std::vector<std::string> FLAG_OPTIONS = {"codes", "descending", "full", "no-register", "stats"};
+
+bool isFlagOption(const std::string& name) {
+    return std::find(FLAG_OPTIONS.begin(), FLAG_OPTIONS.end(), name) != FLAG_OPTIONS.end();
+}
+
+struct CommandArgs {
+    std::vector<std::string> positional;
+    std::unordered_map<std::string, std::string> options;
+
+    bool has(const std::string& name) const { return options.count(name) > 0; }
+
+    std::string get(const std::string& name, const std::string& fallback = "") const {
+        auto it = options.find(name);
+        return it != options.end() ? it->second : fallback;
+    }
+};
+
+CommandArgs parseCommandArgs(const std::vector<std::string>& args, size_t first) {
+    CommandArgs parsed;
+    for (size_t i = first; i < args.size(); i++) {
+        const std::string& arg = args[i];
+        if (arg.size() > 2 && arg.compare(0, 2, "--") == 0) {
+            size_t eq = arg.find('=');
+            if (eq != std::string::npos) {
+                parsed.options[arg.substr(2, eq - 2)] = arg.substr(eq + 1);
+            } else if (!isFlagOption(arg.substr(2)) && i + 1 < args.size() && args[i + 1].compare(0, 2, "--") != 0) {
+                parsed.options[arg.substr(2)] = args[++i];
+            } else {
+                parsed.options[arg.substr(2)] = "";
+            }
+        } else {
+            parsed.positional.push_back(arg);
+        }
+    }
+    return parsed;
+}
+
+// Splits a batch-file line into words; double quotes group words together.
+std::vector<std::string> tokenizeCommandLine(const std::string& line) {
+    std::vector<std::string> words;
+    std::string word;
+    bool quoted = false, inWord = false;
+    for (char c : line) {
+        if (c == '"') {
+            quoted = !quoted;
+            inWord = true;
+        } else if (!quoted && isspace(static_cast<unsigned char>(c))) {
+            if (inWord) words.push_back(word);
+            word.clear();
+            inWord = false;
+        } else {
+            word += c;
+            inWord = true;
+        }
+    }
+    if (inWord) words.push_back(word);
+    return words;
+}
+
+bool parseCode(const std::string& text, int& code) {
+    char extra = 0;
+    return std::sscanf(text.c_str(), "%d%c", &code, &extra) == 1 && code > 0;
+}
+
+void printUsage() {
+    std::cout <<
+        "Usage: payroll [command [arguments]]\n"
+        "With no command, the interactive menu is started.\n\n"
+        "Commands:\n"
+        "  add --name N --address A [--phone P] --date d/m/yyyy --designation D\n"
+        "      --grade A-E [--house Y|N --travel Y|N --salary AMOUNT] [--loan AMOUNT]\n"
+        "  show CODE\n"
+        "  list [--order code|name|grade|salary] [--descending] [--page N [--page-size N]]\n"
+        "  find [--grade G] [--designation D] [--name PREFIX]\n"
+        "      [--joined-from d/m/yyyy] [--joined-to d/m/yyyy] [--codes]\n"
+        "  slip CODE [--days N --hours N]\n"
+        "  modify CODE [--name N] [--address A] [--phone P] [--designation D]\n"
+        "      [--grade G] [--house Y|N] [--travel Y|N] [--salary AMOUNT] [--loan AMOUNT]\n"
+        "  delete CODE\n"
+        "  payroll-run [--timesheet FILE] [--output FILE] [--threads N] [--month yyyy-mm]\n"
+        "      [--full] [--no-register]\n"
+        "                      pay everyone, recalculating only staff changed since the last run\n"
+        "  slips [--grade G] [--designation D] [--timesheet FILE] [--output FILE] [--threads N]\n"
+        "                      write every matching salary slip to one paginated file\n"
+        "  analytics [--by grade|designation|year] [--column net] [--timesheet FILE]\n"
+        "      [--threads N] [--csv FILE]\n"
+        "                      pay totals, averages and ranges by grade, designation and year\n"
+        "  archive-totals [--month yyyy-mm | --year yyyy] [--by grade|designation] [--column net]\n"
+        "                      totals from archived payroll runs (default: this year to date)\n"
+        "  archive-ytd CODE [--month yyyy-mm | --year yyyy]\n"
+        "                      one employee's archived pay month by month\n"
+        "  import FILE\n"
+        "  export [FILE]\n"
+        "  compact\n"
+        "  batch FILE          run one command per line ('-' reads stdin)\n"
+        "  self-test           check the vector salary kernel and incremental payroll\n"
+        "  bench [--sizes 10000,100000,1000000] [--repeats N] [--lookups N] [--file F]\n"
+        "                      time storage, lookup, listing and salary paths\n"
+        "  serve [--socket FILE] [--metrics FILE [--metrics-interval SECONDS]]\n"
+        "                      keep the roster in memory and answer commands on a local socket\n"
+        "  client [--socket FILE] [--repeat N] [--clients N] COMMAND [arguments]\n"
+        "                      send a command to a running service; --repeat load-tests it\n"
+        "  stats               timings, bytes moved and allocations so far; on its own it\n"
+        "                      has nothing to report, so use --stats or 'client stats'\n"
+        "  rules               the salary rules in force for each grade\n"
+        "  branch-add NAME     split the roster into branches, or add a branch\n"
+        "  branches            list the branches with their employee counts\n\n"
+        "Once there are branches, add, import and serve take --branch NAME; commands naming\n"
+        "an employee go to that employee's branch, and list, find, slips, export,\n"
+        "analytics and payroll-run cover every branch.\n"
+        "Any command accepts --stats to print the same figures to stderr when it finishes.\n"
+        "Commands that pay employees first read the salary rules from SALARY_RULES.CSV\n"
+        "when it exists.\n";
+}
+
+// Benchmarks
+const char* const BENCH_DESIGNATIONS[] = {
+    "CLERK", "CLERK", "CLERK", "ACCOUNTANT", "ENGINEER", "ENGINEER",
+    "TECHNICIAN", "SUPERVISOR", "MANAGER", "DIRECTOR"
+};
+
+// Builds a synthetic roster with a realistic grade mix: few senior grades,
+// most staff in C and D, and a fifth on daily wages (grade E).
+std::vector<Employee> generateRoster(size_t count, uint32_t seed) {
+    std::vector<Employee> roster(count);
+    auto next = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return seed >> 8;
+    };
+
+    for (size_t i = 0; i < count; i++) {
+        Employee& emp = roster[i];
+        emp.code = static_cast<int>(i + 1);
+        emp.name = "EMPLOYEE " + std::to_string(i + 1);
+        emp.address = std::to_string(next() % 999 + 1) + " INDUSTRIAL ESTATE ROAD, SECTOR " +
+                      std::to_string(next() % 40 + 1);
+        emp.phone = "555-" + std::to_string(1000000 + next() % 9000000);
+        emp.dd = static_cast<int>(next() % 28 + 1);
+        emp.mm = static_cast<int>(next() % 12 + 1);
+        emp.yy = static_cast<int>(1990 + next() % 35);
+
+        uint32_t roll = next() % 100;
+        emp.grade = roll < 5 ? 'A' : roll < 20 ? 'B' : roll < 50 ? 'C' : roll < 80 ? 'D' : 'E';
+        emp.designation = BENCH_DESIGNATIONS[(isDailyGrade(emp.grade) ? 0 : 4 - (emp.grade - 'A')) +
+                                             next() % 6];
+        if (!isDailyGrade(emp.grade)) {
+            emp.house_allowance = (next() % 3 != 0) ? 'Y' : 'N';
+            emp.travel_allowance = (next() % 2 != 0) ? 'Y' : 'N';
+            int64_t ceiling = MAX_AMOUNT.cents / (1 + (emp.grade - 'A'));
+            emp.basic_salary = Money(ceiling / 4 + static_cast<int64_t>(next()) % (ceiling * 3 / 4));
+        }
+        if (next() % 10 < 3) {
+            emp.loan = Money(static_cast<int64_t>(next()) % MAX_AMOUNT.cents);
+        }
+    }
+    return roster;
+}
+
+// Per-operation timings in seconds
+class BenchSamples {
+public:
+    void add(double seconds) { samples.push_back(seconds); }
+
+    double percentile(double p) {
+        if (samples.empty()) return 0.0;
+        std::sort(samples.begin(), samples.end());
+        size_t rank = static_cast<size_t>(p / 100.0 * (samples.size() - 1) + 0.5);
+        return samples[std::min(rank, samples.size() - 1)];
+    }
+
+    double total() const {
+        double sum = 0.0;
+        for (double sample : samples) sum += sample;
+        return sum;
+    }
+
+private:
+    std::vector<double> samples;
+};
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Peak resident set size of this process so far, in KiB (0 if unknown)
+long peakRssKb() {
+#ifdef _WIN32
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+// Discards everything written to it; used to time rendering without a terminal
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+void printBenchRow(size_t size, const char* operation, double items, BenchSamples& samples) {
+    double total = samples.total();
+    char line[160];
+    std::snprintf(line, sizeof(line), "%-9zu %-22s %14.0f/s %12.3f us %12.3f us %10ld KiB\n",
+                  size, operation, total > 0.0 ? items / total : 0.0,
+                  samples.percentile(50) * 1e6, samples.percentile(99) * 1e6, peakRssKb());
+    std::cout << line;
+}
+
+// Times the storage, lookup, rendering and salary paths against synthetic
+// rosters. Each bulk operation is repeated to give p50/p99 figures; lookups
+// are timed one by one. Peak RSS is the process high-water mark so far.
+int runBenchmarks(const CommandArgs& args) {
+    std::vector<size_t> sizes;
+    std::string sizeList = args.get("sizes", "10000,100000,1000000");
+    for (size_t start = 0; start < sizeList.size();) {
+        size_t comma = sizeList.find(',', start);
+        if (comma == std::string::npos) comma = sizeList.size();
+        long value = std::atol(sizeList.substr(start, comma - start).c_str());
+        if (value > 0) sizes.push_back(static_cast<size_t>(value));
+        start = comma + 1;
+    }
+    int repeats = std::max(1, std::atoi(args.get("repeats", "5").c_str()));
+    int lookups = std::max(1, std::atoi(args.get("lookups", "20000").c_str()));
+    std::string dataFile = args.get("file", "BENCH.DAT");
+    std::string indexFile = dataFile + ".IDX";
+    std::string attributeFile = dataFile + ".ATX";
+    std::string journalFile = dataFile + ".JNL";
+    std::string changesFile = dataFile + ".CHG";
+
+    std::cout << std::left << std::setw(10) << "RECORDS" << std::setw(23) << "OPERATION"
+              << std::right << std::setw(16) << "THROUGHPUT" << std::setw(15) << "P50"
+              << std::setw(15) << "P99" << std::setw(14) << "PEAK RSS" << std::endl;
+    printSeparator();
+
+    NullBuffer nullBuffer;
+    std::ostream nullStream(&nullBuffer);
+    for (size_t size : sizes) {
+        std::vector<Employee> roster = generateRoster(size, 20240131u);
+        std::remove(dataFile.c_str());
+        std::remove(indexFile.c_str());
+        std::remove(attributeFile.c_str());
+        std::remove(journalFile.c_str());
+        EmployeeStore store(dataFile, indexFile, attributeFile, journalFile, changesFile);
+
+        BenchSamples writes, reads;
+        for (int i = 0; i < repeats; i++) {
+            auto start = std::chrono::steady_clock::now();
+            store.writeAllRecords(roster);
+            writes.add(secondsSince(start));
+        }
+        printBenchRow(size, "writeAllRecords", double(size) * repeats, writes);
+
+        for (int i = 0; i < repeats; i++) {
+            auto start = std::chrono::steady_clock::now();
+            EmployeeTable loaded = store.readAllRecords();
+            reads.add(secondsSince(start));
+        }
+        printBenchRow(size, "readAllRecords", double(size) * repeats, reads);
+        roster.clear();
+        roster.shrink_to_fit();
+
+        MappedRoster mapped(dataFile);
+        BenchSamples mappedLookups, slotLookups;
+        uint32_t seed = 7;
+        for (int i = 0; i < lookups; i++) {
+            seed = seed * 1664525u + 1013904223u;
+            int code = static_cast<int>((seed >> 8) % size) + 1;
+
+            auto start = std::chrono::steady_clock::now();
+            const EmployeeRecord* rec = store.findRecord(mapped, code);
+            Employee emp = rec ? fromRecord(*rec) : Employee();
+            mappedLookups.add(secondsSince(start));
+
+            start = std::chrono::steady_clock::now();
+            store.findRecord(code, &emp);
+            slotLookups.add(secondsSince(start));
+        }
+        printBenchRow(size, "lookup (display/slip)", lookups, mappedLookups);
+        printBenchRow(size, "lookup (modify/delete)", lookups, slotLookups);
+
+        // The first query builds the attribute index; the rest reuse it
+        BenchSamples queries;
+        EmployeeQuery query;
+        query.grade = 'C';
+        query.designation = "ENGINEER";
+        query.namePrefix = "EMPLOYEE 1";
+        for (int i = 0; i <= repeats; i++) {
+            auto start = std::chrono::steady_clock::now();
+            store.queryCodes(query);
+            if (i > 0) queries.add(secondsSince(start));
+        }
+        printBenchRow(size, "query (3 criteria)", repeats, queries);
+
+        BenchSamples listing;
+        for (int i = 0; i < repeats; i++) {
+            auto start = std::chrono::steady_clock::now();
+            ReportBuffer out(nullStream);
+            for (const auto& rec : mapped) {
+                if (!(rec.flags & RECORD_DELETED)) displayForList(rec, out);
+            }
+            out.flush();
+            listing.add(secondsSince(start));
+        }
+        printBenchRow(size, "list rendering", double(size) * repeats, listing);
+
+        BenchSamples scalar, batch;
+        Money checksum;
+        for (int i = 0; i < repeats; i++) {
+            auto start = std::chrono::steady_clock::now();
+            for (const auto& rec : mapped) {
+                checksum += calculateSalary(rec, 22, 4).net;
+            }
+            scalar.add(secondsSince(start));
+
+            Timesheet sheet;
+            std::vector<PayrollResult> results;
+            start = std::chrono::steady_clock::now();
+            checksum += runPayroll(mapped, sheet, results).net;
+            batch.add(secondsSince(start));
+        }
+        printBenchRow(size, "salary (per record)", double(size) * repeats, scalar);
+        printBenchRow(size, "salary (batch run)", double(size) * repeats, batch);
+        volatile int64_t sink = checksum.cents;  // Keeps the loops from being optimised away
+        (void)sink;
+        printSeparator();
+    }
+
+    std::remove(dataFile.c_str());
+    std::remove(indexFile.c_str());
+    std::remove(attributeFile.c_str());
+    std::remove(journalFile.c_str());
+    std::remove((dataFile + ".LCK").c_str());
+    return 0;
+}
+
+// Payroll service: a long-running process that keeps the roster in memory
+// and answers commands over a local socket. The client sends one command
+// per line, written as in a batch file; each reply is a line
+// "<exit status> <length>" followed by exactly length bytes of output.
+const std::string SOCKET_FILE_NAME = "PAYROLL.SOCK";
+
+// Every slot of the data file held in memory, in file order, so a
+// MappedRoster view can be laid over it and the read commands work
+// unchanged. Changes written through the store are applied in place; before
+// each request the file header is compared with the cached one, and the
+// roster is reloaded if another process has changed the file.
+class RosterCache {
+public:
+    bool load(EmployeeStore& store);
+    bool refresh(EmployeeStore& store);
+    void apply(const FileHeader& before, const FileHeader& after, const std::vector<JournalSlot>& changed);
+
+    MappedRoster view() const {
+        return MappedRoster(slots.data(), static_cast<uint32_t>(slots.size()), header);
+    }
+    uint32_t liveCount() const {
+        return static_cast<uint32_t>(slots.size()) - std::min<uint32_t>(slots.size(), header.deleted_count);
+    }
+
+private:
+    FileHeader header{};
+    std::vector<EmployeeRecord> slots;
+    bool loaded = false;
+};
+
+bool RosterCache::load(EmployeeStore& store) {
+    loaded = store.readSlots(slots, header);
+    if (!loaded) {
+        slots.clear();
+        header = FileHeader{};
+    }
+    return loaded;
+}
+
+// Costs one header read when nothing has changed
+bool RosterCache::refresh(EmployeeStore& store) {
+    FileHeader current;
+    if (!store.readFileHeader(current)) {
+        return !loaded || load(store);
+    }
+    if (loaded && std::memcmp(&current, &header, sizeof(FileHeader)) == 0) {
+        return true;
+    }
+    return load(store);
+}
+
+// Applies a change the store has written. If the cache was not at the
+// change's starting point, it is left for refresh() to reload.
+void RosterCache::apply(const FileHeader& before, const FileHeader& after, const std::vector<JournalSlot>& changed) {
+    if (!loaded || std::memcmp(&before, &header, sizeof(FileHeader)) != 0) {
+        return;
+    }
+    for (const auto& entry : changed) {
+        if (entry.slot >= slots.size()) {
+            slots.resize(entry.slot + 1);
+        }
+        slots[entry.slot] = entry.rec;
+    }
+    header = after;
+}
+
+#ifndef _WIN32
+// Connects to a service socket; returns -1 if nothing is listening there.
+int connectService(const std::string& path) {
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path)) {
+        return -1;
+    }
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+bool sendAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t sent = write(fd, data, size);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent <= 0) return false;
+        data += sent;
+        size -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+// Reads one reply. pending carries bytes read past the end of the reply.
+bool readReply(int fd, std::string& pending, int& status, std::string& body) {
+    char buffer[65536];
+    size_t length = 0, headerEnd = std::string::npos;
+    for (;;) {
+        if (headerEnd == std::string::npos && (headerEnd = pending.find('\n')) != std::string::npos) {
+            if (std::sscanf(pending.c_str(), "%d %zu", &status, &length) != 2) {
+                return false;
+            }
+        }
+        if (headerEnd != std::string::npos && pending.size() >= headerEnd + 1 + length) {
+            body.assign(pending, headerEnd + 1, length);
+            pending.erase(0, headerEnd + 1 + length);
+            return true;
+        }
+        ssize_t got = read(fd, buffer, sizeof(buffer));
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        pending.append(buffer, static_cast<size_t>(got));
+    }
+}
+#endif
+
+// Sends one command to a running service and prints its output. With
+// --repeat the command is sent that many times on each of --clients
+// connections at once, and only the latency figures are printed.
+int runClient(const std::vector<std::string>& args) {
+#ifdef _WIN32
+    (void)args;
+    std::cerr << "client: the payroll service is not available on this platform\n";
+    return 1;
+#else
+    std::string path = SOCKET_FILE_NAME;
+    long repeat = 0, clients = 1;
+    size_t first = 1;
+    for (; first < args.size() && args[first].compare(0, 2, "--") == 0; first++) {
+        std::string option = args[first].substr(2), value;
+        size_t equals = option.find('=');
+        if (equals != std::string::npos) {
+            value = option.substr(equals + 1);
+            option.resize(equals);
+        } else if (first + 1 < args.size()) {
+            value = args[++first];
+        }
+        char* end = nullptr;
+        if (option == "socket") {
+            path = value;
+        } else if (option == "repeat" || option == "clients") {
+            long number = std::strtol(value.c_str(), &end, 10);
+            if (value.empty() || *end != '\0' || number < 1) {
+                std::cerr << "client: --" << option << " must be a positive number\n";
+                return 1;
+            }
+            (option == "repeat" ? repeat : clients) = number;
+        } else {
+            std::cerr << "client: unknown option --" << option << "\n";
+            return 1;
+        }
+    }
+    if (first >= args.size()) {
+        std::cerr << "client: missing command\n";
+        return 1;
+    }
+
+    std::string request;
+    for (size_t i = first; i < args.size(); i++) {
+        if (!request.empty()) request += ' ';
+        bool quote = args[i].empty() || args[i].find_first_of(" \t") != std::string::npos;
+        request += quote ? "\"" + args[i] + "\"" : args[i];
+    }
+    request += '\n';
+    std::signal(SIGPIPE, SIG_IGN);
+
+    if (repeat == 0) {
+        int fd = connectService(path);
+        if (fd < 0) {
+            std::cerr << "client: no payroll service is listening on " << path << "\n";
+            return 1;
+        }
+        std::string pending, body;
+        int status = 1;
+        bool ok = sendAll(fd, request.data(), request.size()) && readReply(fd, pending, status, body);
+        close(fd);
+        if (!ok) {
+            std::cerr << "client: the service closed the connection\n";
+            return 1;
+        }
+        (status == 0 ? std::cout : std::cerr) << body;
+        return status;
+    }
+
+    // Load test: each connection sends its requests one after another
+    std::vector<std::vector<double>> latencies(static_cast<size_t>(clients));
+    std::atomic<long> failed{0};
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (long c = 0; c < clients; c++) {
+        workers.emplace_back([&, c] {
+            int fd = connectService(path);
+            if (fd < 0) {
+                failed += repeat;
+                return;
+            }
+            std::string pending, body;
+            for (long r = 0; r < repeat; r++) {
+                auto sent = std::chrono::steady_clock::now();
+                int status = 1;
+                if (!sendAll(fd, request.data(), request.size()) || !readReply(fd, pending, status, body)) {
+                    failed += repeat - r;
+                    break;
+                }
+                latencies[static_cast<size_t>(c)].push_back(secondsSince(sent));
+                if (status != 0) failed++;
+            }
+            close(fd);
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    double elapsed = secondsSince(start);
+
+    BenchSamples samples;
+    size_t answered = 0;
+    for (const auto& connection : latencies) {
+        for (double seconds : connection) samples.add(seconds);
+        answered += connection.size();
+    }
+    char line[200];
+    std::snprintf(line, sizeof(line), "%zu requests on %ld connection(s): %.0f/s, p50 %.3f us, p99 %.3f us, %ld failed\n",
+                  answered, clients, elapsed > 0.0 ? answered / elapsed : 0.0,
+                  samples.percentile(50) * 1e6, samples.percentile(99) * 1e6, failed.load());
+    std::cout << line;
+    return failed == 0 ? 0 : 1;
+#endif
+}
+
+// Replaces the metrics file in one rename, so a reader never sees half a dump
+bool writeMetricsFile(const std::string& fileName) {
+    const std::string tempName = processTempName(fileName);
+    std::ofstream file(tempName, std::ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+    printMetrics(file);
+    file.close();
+    return replaceFile(tempName, fileName, static_cast<bool>(file));
+}
+
+class PayrollSystem {
+private:
+    EmployeeStore store;
+    RosterCache* cache = nullptr;       // Set while serving
+    std::string branchName;             // Set for one branch of a sharded roster
+    std::string resultsFile = PAYROLL_RESULTS_FILE_NAME;
+
+    // Once PAYROLL.MAN exists this object only routes: each command goes to
+    // one PayrollSystem per branch, opened on first use, or is run over the
+    // branches' employees merged in code order
+    std::unique_ptr<BranchManifest> manifest;
+    std::vector<std::unique_ptr<PayrollSystem>> branches;
+    std::vector<EmployeeRecord> merged;
+
+    void editMenu();
+    MappedRoster openRoster();
+public:
+    PayrollSystem() = default;
+    PayrollSystem(BranchManifest& manifest, uint32_t branch);
+
+    void mainMenu();
+    void newEmployee();
+    void displayEmployee();
+    void listEmployees();
+    void searchEmployees();
+    void salarySlip();
+    void deleteEmployee();
+    void modifyEmployee();
+    void compactDataFile();
+    void payrollRun();
+    void printSalarySlips();
+    void importEmployees();
+    void exportEmployees();
+    void showStatistics();
+
+    // Non-interactive mode: no prompts, no screen clearing
+    int runCommand(const std::vector<std::string>& args);
+    int runBatch(const std::string& fileName);
+    int serve(const CommandArgs& args);
+
+private:
+    int dispatchCommand(const std::string& command, const CommandArgs& args);
+    std::string serveRequest(const std::string& line);
+    bool loadBranches();
+    PayrollSystem& branch(uint32_t index);
+    void forEachBranch(const std::function<void(PayrollSystem& branch, uint32_t index)>& work);
+    int routeCommand(const std::string& command, const CommandArgs& args);
+    void mergeBranches(const EmployeeQuery* query);
+    PayrollTotals payBranches(const Timesheet& sheet, bool full, unsigned threads,
+                              std::vector<PayrollResult>* results, size_t& recomputed);
+    int commandBranchAdd(const CommandArgs& args);
+    int commandBranches(const CommandArgs& args);
+    int commandAdd(const CommandArgs& args);
+    int commandShow(const CommandArgs& args);
+    int commandList(const CommandArgs& args);
+    int commandFind(const CommandArgs& args);
+    int commandSlip(const CommandArgs& args);
+    int commandModify(const CommandArgs& args);
+    int commandDelete(const CommandArgs& args);
+    int commandPayrollRun(const CommandArgs& args);
+    int commandSlips(const CommandArgs& args);
+    int commandImport(const CommandArgs& args);
+    int commandExport(const CommandArgs& args);
+    int commandAnalytics(const CommandArgs& args);
+    int commandArchiveTotals(const CommandArgs& args);
+    int commandArchiveYtd(const CommandArgs& args);
+};
+
+// The store files of a branch are named after it; the codes it hands out
+// come from the manifest
+PayrollSystem::PayrollSystem(BranchManifest& manifest, uint32_t branch)
+    : store(manifest.file(branch, ".DAT"), manifest.file(branch, ".IDX"), manifest.file(branch, ".ATX"),
+            manifest.file(branch, ".JNL"), manifest.file(branch, ".CHG")),
+      branchName(manifest.name(branch)), resultsFile(manifest.file(branch, ".RES")) {
+    store.setCodeSource([&manifest, branch](int lastCode, bool lease) {
+        return manifest.nextCode(branch, lastCode, lease);
+    });
+}
+
+// The roster for read-only work: the service's cache while serving, every
+// branch merged for a sharded roster, otherwise a fresh mapping of the data
+// file
+MappedRoster PayrollSystem::openRoster() {
+    if (cache) {
+        return cache->view();
+    }
+    if (manifest) {
+        mergeBranches(nullptr);
+        return MappedRoster(merged.data(), static_cast<uint32_t>(merged.size()), FileHeader{});
+    }
+    return MappedRoster(store.fileName());
+}
+
+// Starts routing if PAYROLL.MAN exists, unless this is itself a branch.
+// Fails only for a manifest that exists but cannot be read.
+bool PayrollSystem::loadBranches() {
+    if (manifest || !branchName.empty()) {
+        return true;
+    }
+    auto loaded = std::make_unique<BranchManifest>();
+    if (!loaded->exists()) {
+        return true;
+    }
+    if (!loaded->load()) {
+        std::cerr << "Error: cannot read " << MANIFEST_FILE_NAME << ".\n";
+        return false;
+    }
+    manifest = std::move(loaded);
+    return true;
+}
+
+PayrollSystem& PayrollSystem::branch(uint32_t index) {
+    if (branches.size() < manifest->size()) {
+        branches.resize(manifest->size());
+    }
+    if (!branches[index]) {
+        branches[index] = std::make_unique<PayrollSystem>(*manifest, index);
+        branches[index]->store.open();
+    }
+    return *branches[index];
+}
+
+// Runs work for every branch at once, one thread per branch. The branches
+// are opened first, since opening may replay a journal.
+void PayrollSystem::forEachBranch(const std::function<void(PayrollSystem& branch, uint32_t index)>& work) {
+    uint32_t count = manifest->size();
+    for (uint32_t i = 0; i < count; i++) {
+        branch(i);
+    }
+    std::vector<std::thread> pool;
+    for (uint32_t i = 1; i < count; i++) {
+        pool.emplace_back([&work, this, i]() { work(*branches[i], i); });
+    }
+    if (count > 0) {
+        work(*branches[0], 0);
+    }
+    for (auto& thread : pool) {
+        thread.join();
+    }
+}
+
+// Sends a command to the branch that should run it: an employee's code
+// leads to its branch, and add, import and serve need --branch unless there
+// is only one. Listings, searches, slips, exports and the payroll run cover
+// every branch.
+int PayrollSystem::routeCommand(const std::string& command, const CommandArgs& args) {
+    if (command == "branches") return commandBranches(args);
+    if (command == "batch") return dispatchCommand(command, args);
+    if (args.has("branch")) {
+        if (command == "payroll-run") {
+            std::cerr << "payroll-run: all branches are paid together; --branch is not accepted\n";
+            return 1;
+        }
+        std::string name = args.get("branch");
+        std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+        long selected = manifest->find(name);
+        if (selected < 0) {
+            std::cerr << "Error: there is no branch " << name << ".\n";
+            return 1;
+        }
+        PayrollSystem& target = branch(static_cast<uint32_t>(selected));
+        return command == "serve" ? target.serve(args) : target.dispatchCommand(command, args);
+    }
+    if (command == "show" || command == "slip" || command == "modify" || command == "delete") {
+        int code = 0;
+        long owner = !args.positional.empty() && parseCode(args.positional[0], code) ? manifest->ownerOf(code) : -1;
+        // A code never handed out goes to the first branch, which reports it
+        return branch(owner < 0 ? 0 : static_cast<uint32_t>(owner)).dispatchCommand(command, args);
+    }
+    if (command == "add" || command == "import" || command == "serve") {
+        if (manifest->size() != 1) {
+            std::cerr << command << ": --branch is required when there are several branches\n";
+            return 1;
+        }
+        return command == "serve" ? branch(0).serve(args) : branch(0).dispatchCommand(command, args);
+    }
+    if (command == "compact") {
+        int status = 0;
+        for (uint32_t i = 0; i < manifest->size(); i++) {
+            status |= branch(i).dispatchCommand(command, args);
+        }
+        return status;
+    }
+    return dispatchCommand(command, args);
+}
+
+// Copies the live employees of every branch, or only those matching query,
+// into merged in code order. The branches are read in parallel.
+void PayrollSystem::mergeBranches(const EmployeeQuery* query) {
+    std::vector<std::vector<EmployeeRecord>> parts(manifest->size());
+    forEachBranch([&parts, query](PayrollSystem& branch, uint32_t index) {
+        std::vector<EmployeeRecord>& part = parts[index];
+        MappedRoster roster(branch.store.fileName());
+        if (query) {
+            for (int code : branch.store.queryCodes(*query)) {
+                if (const EmployeeRecord* rec = branch.store.findRecord(roster, code)) {
+                    part.push_back(*rec);
+                }
+            }
+            return;
+        }
+        countRecordsScanned(roster.size());
+        part.reserve(roster.liveCount());
+        for (const auto& rec : roster) {
+            if (!(rec.flags & RECORD_DELETED)) part.push_back(rec);
+        }
+        // Codes only grow within one data file, so this is normally a check
+        auto byCode = [](const EmployeeRecord& a, const EmployeeRecord& b) { return a.code < b.code; };
+        if (!std::is_sorted(part.begin(), part.end(), byCode)) {
+            std::sort(part.begin(), part.end(), byCode);
+        }
+    });
+
+    std::vector<size_t> sizes;
+    size_t total = 0;
+    for (const auto& part : parts) {
+        sizes.push_back(part.size());
+        total += part.size();
+    }
+    merged.clear();
+    merged.reserve(total);
+    mergeByCode(sizes, [&parts](size_t run, size_t i) { return parts[run][i].code; },
+                [&](size_t run, size_t i) { merged.push_back(parts[run][i]); });
+}
+
+// Pays every branch in parallel, each against its own saved results, and
+// merges the register rows by code. The rows index merged, which receives
+// the employees paid.
+PayrollTotals PayrollSystem::payBranches(const Timesheet& sheet, bool full, unsigned threads,
+                                         std::vector<PayrollResult>* results, size_t& recomputed) {
+    uint32_t count = manifest->size();
+    std::vector<std::unique_ptr<MappedRoster>> rosters(count);
+    std::vector<std::vector<PayrollResult>> paid(count);
+    std::vector<PayrollTotals> totals(count);
+    std::vector<size_t> recalculated(count, 0);
+    unsigned perBranch = std::max(1u, resolveThreadCount(threads) / std::max(count, 1u));
+    forEachBranch([&](PayrollSystem& branch, uint32_t index) {
+        LockGuard writers = branch.store.lockWriters();
+        rosters[index] = std::make_unique<MappedRoster>(branch.store.fileName());
+        totals[index] = runSavedPayroll(branch.store, *rosters[index], sheet, full, perBranch,
+                                        results ? &paid[index] : nullptr, recalculated[index], branch.resultsFile);
+    });
+
+    PayrollTotals sum;
+    recomputed = 0;
+    std::vector<size_t> sizes;
+    for (uint32_t i = 0; i < count; i++) {
+        sum.merge(totals[i]);
+        recomputed += recalculated[i];
+        sizes.push_back(paid[i].size());
+    }
+    if (results) {
+        merged.clear();
+        merged.reserve(sum.employees);
+        results->clear();
+        results->reserve(sum.employees);
+        mergeByCode(sizes, [&](size_t run, size_t i) { return (*rosters[run])[paid[run][i].slot].code; },
+                    [&](size_t run, size_t i) {
+                        results->push_back({static_cast<uint32_t>(merged.size()), paid[run][i].pay});
+                        merged.push_back((*rosters[run])[paid[run][i].slot]);
+                    });
+    }
+    return sum;
+}
+
+void PayrollSystem::mainMenu() {
+    if (!loadBranches()) {
+        return;
+    }
+    // A sharded roster is worked on one branch at a time
+    if (manifest) {
+        std::cout << "Branches:\n";
+        for (uint32_t i = 0; i < manifest->size(); i++) {
+            std::cout << "  " << std::setw(3) << i + 1 << ". " << manifest->name(i) << "\n";
+        }
+        std::cout << "Enter branch number: ";
+        uint32_t selected = 0;
+        if (!(std::cin >> selected) || selected < 1 || selected > manifest->size()) {
+            std::cout << "\nNo such branch.\n";
+            return;
+        }
+        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        branch(selected - 1).mainMenu();
+        return;
+    }
+
+    int choice;
+    store.open();
+    
+    while (true) {
+        clearScreen();
+        printHeader(branchName.empty() ? "PAYROLL MANAGEMENT SYSTEM" : "PAYROLL MANAGEMENT SYSTEM - " + branchName);
+        
+        std::cout << "\n\n";
+        std::cout << "        1. NEW EMPLOYEE\n";
+        std::cout << "        2. DISPLAY EMPLOYEE\n";
+        std::cout << "        3. LIST OF EMPLOYEES\n";
+        std::cout << "        4. SALARY SLIP\n";
+        std::cout << "        5. EDIT MENU\n";
+        std::cout << "        6. MONTHLY PAYROLL RUN\n";
+        std::cout << "        7. IMPORT EMPLOYEES (CSV)\n";
+        std::cout << "        8. EXPORT EMPLOYEES (CSV)\n";
+        std::cout << "        9. PRINT ALL SALARY SLIPS\n";
+        std::cout << "       10. SEARCH EMPLOYEES\n";
+        std::cout << "       11. STATISTICS\n";
+        std::cout << "        0. QUIT\n\n";
+        std::cout << "Enter your choice (0-11): ";
+        
+        std::cin >> choice;
+        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        
+        switch (choice) {
+            case 0:
+                std::cout << "\nThank you for using Payroll Management System!\n";
+                return;
+            case 1:
+                newEmployee();
+                break;
+            case 2:
+                displayEmployee();
+                break;
+            case 3:
+                listEmployees();
+                break;
+            case 4:
+                salarySlip();
+                break;
+            case 5:
+                editMenu();
+                break;
+            case 6:
+                payrollRun();
+                break;
+            case 7:
+                importEmployees();
+                break;
+            case 8:
+                exportEmployees();
+                break;
+            case 9:
+                printSalarySlips();
+                break;
+            case 10:
+                searchEmployees();
+                break;
+            case 11:
+                showStatistics();
+                break;
+            default:
+                std::cout << "\nInvalid choice! Please enter 0-11.\n";
+                pauseScreen();
+                break;
+        }
+    }
+}
+
+void PayrollSystem::editMenu() {
+    int choice;
+    
+    while (true) {
+        clearScreen();
+        printHeader("EDIT MENU");
+        
+        std::cout << "\n\n";
+        std::cout << "        1. DELETE RECORD\n";
+        std::cout << "        2. MODIFY RECORD\n";
+        std::cout << "        3. COMPACT DATA FILE\n";
+        std::cout << "        0. BACK TO MAIN MENU\n\n";
+        std::cout << "Enter your choice (0-3): ";
+        
+        std::cin >> choice;
+        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        
+        switch (choice) {
+            case 0:
+                return;
+            case 1:
+                deleteEmployee();
+                break;
+            case 2:
+                modifyEmployee();
+                break;
+            case 3:
+                compactDataFile();
+                break;
+            default:
+                std::cout << "\nInvalid choice! Please enter 0-3.\n";
+                pauseScreen();
+                break;
+        }
+    }
+}
+
+void PayrollSystem::newEmployee() {
+    clearScreen();
+    printHeader("ADD NEW EMPLOYEE");
+    
+    Employee newEmp;
+
+    // Auto-generate employee code. The code is assigned when the record is
+    // saved; another clerk saving first moves it on.
+    newEmp.code = store.nextEmployeeCode();
+    const int previewCode = newEmp.code;
+
+    std::cout << "\nEmployee Code: " << newEmp.code << " (auto-generated)\n";
+    std::cout << "Enter '0' at any prompt to exit\n\n";
+
+    // Get employee details
+    newEmp.name = getValidatedInput("Employee Name", 25);
+    if (newEmp.name == "0") return;
+
+    newEmp.address = getValidatedInput("Address", 50);
+    if (newEmp.address == "0") return;
+
+    bool validPhone = false;
+    do {
+        std::cout << "Phone Number (or press Enter for none): ";
+        std::getline(std::cin, newEmp.phone);
+        if (newEmp.phone == "0") return;
+        validPhone = newEmp.phone.length() <= static_cast<size_t>(PHONE_WIDTH);
+        if (!validPhone) {
+            std::cout << "Invalid input! Length should be at most " << PHONE_WIDTH << " characters.\n";
+        }
+    } while (!validPhone);
+    if (newEmp.phone.empty()) newEmp.phone = "-";
+
+    // Date input with validation
+    bool validDate = false;
+    do {
+        std::cout << "\nJoining Date:\n";
+        std::cout << "Day (1-31): ";
+        std::cin >> newEmp.dd;
+        std::cout << "Month (1-12): ";
+        std::cin >> newEmp.mm;
+        std::cout << "Year (1900-2100): ";
+        std::cin >> newEmp.yy;
+        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        
+        if (std::cin.fail()) {
+            std::cin.clear();
+            std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            std::cout << "Invalid input! Please enter numbers only.\n";
+            validDate = false;
+        } else {
+            validDate = isValidDate(newEmp.dd, newEmp.mm, newEmp.yy);
+            if (!validDate) {
+                std::cout << "Invalid date! Please re-enter.\n";
+            }
+        }
+    } while (!validDate);
+
+    newEmp.designation = getValidatedInput("Designation", 20);
+    if (newEmp.designation == "0") return;
+
+    // Grade input
+    do {
+        std::cout << "Grade (A/B/C/D/E): ";
+        std::cin >> newEmp.grade;
+        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        newEmp.grade = toupper(newEmp.grade);
+        
+        if (newEmp.grade < 'A' || newEmp.grade > 'E') {
+            std::cout << "Invalid grade! Please enter A, B, C, D, or E.\n";
+        }
+    } while (newEmp.grade < 'A' || newEmp.grade > 'E');
+
+    // Grade-specific inputs
+    std::string input;
+    if (!isDailyGrade(newEmp.grade)) {
+        do {
+            std::cout << "House Allowance (Y/N): ";
+            std::cin >> newEmp.house_allowance;
+            std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            newEmp.house_allowance = toupper(newEmp.house_allowance);
+        } while (newEmp.house_allowance != 'Y' && newEmp.house_allowance != 'N');
+
+        do {
+            std::cout << "Travel Allowance (Y/N): ";
+            std::cin >> newEmp.travel_allowance;
+            std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            newEmp.travel_allowance = toupper(newEmp.travel_allowance);
+        } while (newEmp.travel_allowance != 'Y' && newEmp.travel_allowance != 'N');
+
+        do {
+            std::cout << "Basic Salary (max 50000): $";
+            std::getline(std::cin, input);
+            if (!parseMoney(input, newEmp.basic_salary) || !isValidAmount(newEmp.basic_salary)) {
+                std::cout << "Invalid salary! Please enter a value between 0 and 50000.\n";
+            } else {
+                break;
+            }
+        } while (true);
+    }
+
+    do {
+        std::cout << "Loan Amount (max 50000): $";
+        std::getline(std::cin, input);
+        if (!parseMoney(input, newEmp.loan) || !isValidAmount(newEmp.loan)) {
+            std::cout << "Invalid loan amount! Please enter a value between 0 and 50000.\n";
+        } else {
+            break;
+        }
+    } while (true);
+
+    // Confirm save
+    char saveChoice;
+    std::cout << "\nDo you want to save this record? (Y/N): ";
+    std::cin >> saveChoice;
+    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    
+    if (toupper(saveChoice) == 'Y') {
+        if (store.appendRecord(newEmp)) {
+            std::cout << "\nRecord added successfully!\n";
+            if (newEmp.code != previewCode) {
+                std::cout << "Code " << previewCode << " was taken meanwhile; the employee was saved as code "
+                          << newEmp.code << ".\n";
+            }
+        } else {
+            std::cout << "\nError: could not write to " << store.fileName() << ".\n";
+        }
+    } else {
+        std::cout << "\nRecord not saved.\n";
+    }
+    
+    pauseScreen();
+}
+
+void PayrollSystem::displayEmployee() {
+    clearScreen();
+    printHeader("DISPLAY EMPLOYEE");
+    
+    int searchCode;
+    std::cout << "\nEnter Employee Code (0 to exit): ";
+    std::cin >> searchCode;
+    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+
+    if (searchCode == 0) return;
+
+    MappedRoster roster = openRoster();
+    const EmployeeRecord* rec = store.findRecord(roster, searchCode);
+    if (rec) {
+        std::cout << "\n";
+        fromRecord(*rec).display();
+    } else {
+        std::cout << "\nEmployee with code " << searchCode << " not found!\n";
+    }
+
+    pauseScreen();
+}
+
+void PayrollSystem::listEmployees() {
+    clearScreen();
+    printHeader("LIST OF EMPLOYEES");
+    
+    MappedRoster roster = openRoster();
+
+    if (roster.liveCount() == 0) {
+        std::cout << "\nNo employee records found!\n";
+        pauseScreen();
+        return;
+    }
+
+    std::cout << "\nOrder by 1. code  2. name  3. grade  4. salary [1]: ";
+    std::string input;
+    std::getline(std::cin, input);
+    ListOrder order = ORDER_CODE;
+    if (input.size() == 1 && input[0] >= '1' && input[0] <= '4') {
+        order = static_cast<ListOrder>(input[0] - '1');
+    }
+
+    // Pages are read as they are shown, so quitting early reads no further
+    RosterCursor cursor(roster, manifest ? nullptr : &store, order, false);
+    ReportBuffer out(std::cout);
+    out.endLine();
+    displayListHeader(out);
+    
+    size_t shown = 0;
+    for (auto page = cursor.next(20); !page.empty(); page = cursor.next(20)) {
+        for (const EmployeeRecord* rec : page) {
+            displayForList(*rec, out);
+        }
+        shown += page.size();
+        if (page.size() < 20 || shown >= roster.liveCount()) break;
+
+        out.flush();
+        std::cout << "\nPress Enter to continue or type 'q' and Enter to quit: ";
+        std::getline(std::cin, input);
+        if (!input.empty() && tolower(input[0]) == 'q') break;
+        std::cout << "\n";
+    }
+    
+    out.endLine().text("Total employees: ").text(toText(roster.liveCount())).endLine();
+    out.flush();
+    pauseScreen();
+}
+
+void PayrollSystem::deleteEmployee() {
+    clearScreen();
+    printHeader("DELETE EMPLOYEE");
+    
+    int searchCode;
+    std::cout << "\nEnter Employee Code to delete (0 to exit): ";
+    std::cin >> searchCode;
+    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+
+    if (searchCode == 0) return;
+
+    Employee emp;
+    long slot = store.findRecord(searchCode, &emp);
+
+    if (slot < 0) {
+        std::cout << "\nEmployee with code " << searchCode << " not found!\n";
+        pauseScreen();
+        return;
+    }
+
+    std::cout << "\nEmployee to be deleted:\n";
+    emp.display();
+    
+    char choice;
+    std::cout << "\nAre you sure you want to delete this record? (Y/N): ";
+    std::cin >> choice;
+    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    
+    if (toupper(choice) == 'Y') {
+        if (store.deleteRecord(static_cast<uint32_t>(slot), searchCode)) {
+            std::cout << "\nRecord deleted successfully!\n";
+            if (store.needsCompaction()) {
+                store.compactRecords();
+            }
+        } else {
+            std::cout << "\nError: could not update " << store.fileName() << ".\n";
+        }
+    } else {
+        std::cout << "\nDeletion cancelled.\n";
+    }
+
+    pauseScreen();
+}
+
+void PayrollSystem::modifyEmployee() {
+    clearScreen();
+    printHeader("MODIFY EMPLOYEE");
+    
+    int searchCode;
+    std::cout << "\nEnter Employee Code to modify (0 to exit): ";
+    std::cin >> searchCode;
+    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+
+    if (searchCode == 0) return;
+
+    Employee emp;
+    long slot = store.findRecord(searchCode, &emp);
+
+    if (slot < 0) {
+        std::cout << "\nEmployee with code " << searchCode << " not found!\n";
+        pauseScreen();
+        return;
+    }
+
+    const Employee original = emp;
+    Employee& empToModify = emp;
+    std::cout << "\nCurrent employee details:\n";
+    empToModify.display();
+
+    char choice;
+    std::cout << "\nDo you want to modify this record? (Y/N): ";
+    std::cin >> choice;
+    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    
+    if (toupper(choice) != 'Y') {
+        return;
+    }
+
+    std::cout << "\nEnter new values (press Enter to keep current value):\n\n";
+
+    // Modify fields
+    std::string input;
+    
+    std::cout << "Name [" << empToModify.name << "]: ";
+    std::getline(std::cin, input);
+    if (!input.empty()) {
+        std::transform(input.begin(), input.end(), input.begin(), ::toupper);
+        empToModify.name = input;
+    }
+
+    std::cout << "Address [" << empToModify.address << "]: ";
+    std::getline(std::cin, input);
+    if (!input.empty()) {
+        std::transform(input.begin(), input.end(), input.begin(), ::toupper);
+        empToModify.address = input;
+    }
+
+    std::cout << "Phone [" << empToModify.phone << "]: ";
+    std::getline(std::cin, input);
+    if (input.length() > static_cast<size_t>(PHONE_WIDTH)) {
+        std::cout << "Phone number longer than " << PHONE_WIDTH << " characters - keeping current value.\n";
+    } else if (!input.empty()) {
+        empToModify.phone = input;
+    }
+
+    std::cout << "Designation [" << empToModify.designation << "]: ";
+    std::getline(std::cin, input);
+    if (!input.empty()) {
+        std::transform(input.begin(), input.end(), input.begin(), ::toupper);
+        empToModify.designation = input;
+    }
+
+    std::cout << "Grade [" << empToModify.grade << "] (A/B/C/D/E): ";
+    std::getline(std::cin, input);
+    if (!input.empty() && input.length() == 1) {
+        char newGrade = toupper(input[0]);
+        if (newGrade >= 'A' && newGrade <= 'E') {
+            empToModify.grade = newGrade;
+        }
+    }
+
+    if (!isDailyGrade(empToModify.grade)) {
+        std::cout << "House Allowance [" << empToModify.house_allowance << "] (Y/N): ";
+        std::getline(std::cin, input);
+        if (!input.empty() && input.length() == 1) {
+            char newHouse = toupper(input[0]);
+            if (newHouse == 'Y' || newHouse == 'N') {
+                empToModify.house_allowance = newHouse;
+            }
+        }
+
+        std::cout << "Travel Allowance [" << empToModify.travel_allowance << "] (Y/N): ";
+        std::getline(std::cin, input);
+        if (!input.empty() && input.length() == 1) {
+            char newTravel = toupper(input[0]);
+            if (newTravel == 'Y' || newTravel == 'N') {
+                empToModify.travel_allowance = newTravel;
+            }
+        }
+
+        std::cout << "Basic Salary [" << empToModify.basic_salary << "]: $";
+        std::getline(std::cin, input);
+        if (!input.empty()) {
+            Money newSalary;
+            if (!parseMoney(input, newSalary)) {
+                std::cout << "Invalid salary input - keeping current value.\n";
+            } else if (isValidAmount(newSalary)) {
+                empToModify.basic_salary = newSalary;
+            }
+        }
+    }
+
+    std::cout << "Loan Amount [" << empToModify.loan << "]: $";
+    std::getline(std::cin, input);
+    if (!input.empty()) {
+        Money newLoan;
+        if (!parseMoney(input, newLoan)) {
+            std::cout << "Invalid loan input - keeping current value.\n";
+        } else if (isValidAmount(newLoan)) {
+            empToModify.loan = newLoan;
+        }
+    }
+
+    // Confirm save
+    std::cout << "\nDo you want to save changes? (Y/N): ";
+    std::cin >> choice;
+    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    
+    if (toupper(choice) == 'Y') {
+        EmployeeStore::UpdateStatus status = store.updateRecord(static_cast<uint32_t>(slot), empToModify, &original);
+        if (status == EmployeeStore::UPDATE_DONE) {
+            std::cout << "\nRecord modified successfully!\n";
+        } else if (status == EmployeeStore::UPDATE_CONFLICT) {
+            std::cout << "\nError: employee " << empToModify.code << " was changed by another user. "
+                      << "Changes not saved.\n";
+        } else {
+            std::cout << "\nError: could not update " << store.fileName() << ".\n";
+        }
+    } else {
+        std::cout << "\nChanges not saved.\n";
     }
 
     pauseScreen();
 }
 
-void PayrollSystem::listEmployees() {
+void PayrollSystem::compactDataFile() {
     clearScreen();
-    printHeader("LIST OF EMPLOYEES");
-    
-    std::vector<Employee> allEmployees = readAllRecords();
+    printHeader("COMPACT DATA FILE");
 
-    if (allEmployees.empty()) {
-        std::cout << "\nNo employee records found!\n";
+    if (store.compactRecords()) {
+        std::cout << "\nDeleted records have been removed from " << store.fileName() << ".\n";
+    } else {
+        std::cout << "\nError: could not rewrite " << store.fileName() << ".\n";
+    }
+
+    pauseScreen();
+}
+
+void PayrollSystem::searchEmployees() {
+    clearScreen();
+    printHeader("SEARCH EMPLOYEES");
+
+    EmployeeQuery query;
+    std::string input;
+    std::cout << "\nLeave a field blank to match everyone.\n";
+    std::cout << "\nGrade (A-E): ";
+    std::getline(std::cin, input);
+    if (!input.empty() && !parseGrade(input, query.grade)) {
+        std::cout << "\nInvalid grade! Please enter A-E.\n";
         pauseScreen();
         return;
     }
 
-    std::cout << "\n";
-    std::cout << std::left 
-              << std::setw(6) << "CODE"
-              << std::setw(20) << "NAME"
-              << std::setw(12) << "PHONE"
-              << std::setw(12) << "DOJ"
-              << std::setw(15) << "DESIGNATION"
-              << std::setw(6) << "GRADE"
-              << std::setw(10) << "SALARY" << std::endl;
-    
-    printSeparator();
-    
-    int count = 0;
-    for (const auto& emp : allEmployees) {
-        emp.displayForList();
-        count++;
-        
-        // Pagination for large lists
-        if (count % 20 == 0) {
+    std::cout << "Designation: ";
+    std::getline(std::cin, query.designation);
+    std::cout << "Name starts with: ";
+    std::getline(std::cin, query.namePrefix);
+    std::transform(query.designation.begin(), query.designation.end(), query.designation.begin(), ::toupper);
+    std::transform(query.namePrefix.begin(), query.namePrefix.end(), query.namePrefix.begin(), ::toupper);
+
+    for (int* bound : {&query.joinedFrom, &query.joinedTo}) {
+        std::cout << (bound == &query.joinedFrom ? "Joined on or after (d/m/yyyy): "
+                                                 : "Joined on or before (d/m/yyyy): ");
+        std::getline(std::cin, input);
+        int d = 0, m = 0, y = 0;
+        if (input.empty()) continue;
+        if (!parseDate(input, d, m, y) || !isValidDate(d, m, y)) {
+            std::cout << "\nInvalid date!\n";
+            pauseScreen();
+            return;
+        }
+        *bound = y * 10000 + m * 100 + d;
+    }
+
+    std::vector<int> codes = store.queryCodes(query);
+    if (codes.empty()) {
+        std::cout << "\nNo matching employees found!\n";
+        pauseScreen();
+        return;
+    }
+
+    MappedRoster roster = openRoster();
+    ReportBuffer out(std::cout);
+    out.endLine();
+    displayListHeader(out);
+
+    size_t count = 0;
+    for (int code : codes) {
+        const EmployeeRecord* rec = store.findRecord(roster, code);
+        if (!rec) continue;
+        displayForList(*rec, out);
+
+        if (++count % 20 == 0) {
+            out.flush();
             std::cout << "\nPress Enter to continue or type 'q' and Enter to quit: ";
-            std::string input;
             std::getline(std::cin, input);
             if (!input.empty() && tolower(input[0]) == 'q') break;
             std::cout << "\n";
         }
     }
-    
-    std::cout << "\nTotal employees: " << allEmployees.size() << std::endl;
+
+    out.endLine().text("Matching employees: ").text(toText(static_cast<int64_t>(codes.size()))).endLine();
+    out.flush();
     pauseScreen();
 }
 
-void PayrollSystem::deleteEmployee() {
+void PayrollSystem::salarySlip() {
     clearScreen();
-    printHeader("DELETE EMPLOYEE");
+    printHeader("SALARY SLIP");
     
     int searchCode;
-    std::cout << "\nEnter Employee Code to delete (0 to exit): ";
+    std::cout << "\nEnter Employee Code (0 to exit): ";
     std::cin >> searchCode;
     std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
 
     if (searchCode == 0) return;
 
-    std::vector<Employee> allEmployees = readAllRecords();
-    auto it = std::find_if(allEmployees.begin(), allEmployees.end(), 
-                          [searchCode](const Employee& emp) {
-                              return emp.code == searchCode;
-                          });
+    MappedRoster roster = openRoster();
+    const EmployeeRecord* rec = store.findRecord(roster, searchCode);
 
-    if (it == allEmployees.end()) {
+    if (!rec) {
         std::cout << "\nEmployee with code " << searchCode << " not found!\n";
         pauseScreen();
         return;
     }
 
-    std::cout << "\nEmployee to be deleted:\n";
-    it->display();
-    
-    char choice;
-    std::cout << "\nAre you sure you want to delete this record? (Y/N): ";
-    std::cin >> choice;
-    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    const Employee emp = fromRecord(*rec);
+
+    clearScreen();
+    std::tm today = currentDate();
+    {
+        ReportBuffer out(std::cout);
+        printSlipHeading(out, emp.name, emp.designation, emp.grade, today);
+    }
+
+    int days = 0, hours = 0;
+
+    if (isDailyGrade(emp.grade)) {
+        do {
+            std::cout << "\nDays worked this month (0-31): ";
+            std::cin >> days;
+            if (std::cin.fail() || days < 0 || days > 31) {
+                std::cin.clear();
+                std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+                std::cout << "Invalid input! Please enter 0-31.\n";
+            } else {
+                break;
+            }
+        } while (true);
+
+        do {
+            std::cout << "Overtime hours (0 or more): ";
+            std::cin >> hours;
+            if (std::cin.fail() || hours < 0) {
+                std::cin.clear();
+                std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+                std::cout << "Invalid input! Please enter 0 or more.\n";
+            } else {
+                break;
+            }
+        } while (true);
+    }
+
+    {
+        ReportBuffer out(std::cout);
+        printSlipBreakdown(out, emp.grade, calculateSalary(emp, days, hours));
+    }
     
-    if (toupper(choice) == 'Y') {
-        allEmployees.erase(it);
-        writeAllRecords(allEmployees);
-        std::cout << "\nRecord deleted successfully!\n";
+    pauseScreen();
+}
+
+void PayrollSystem::payrollRun() {
+    clearScreen();
+    printHeader("MONTHLY PAYROLL RUN");
+    if (!branchName.empty()) {
+        std::cout << "\nAll branches are paid together; run 'payroll payroll-run' from the command line.\n";
+        pauseScreen();
+        return;
+    }
+
+    std::string timesheetName, registerName;
+    std::cout << "\nGrade E timesheet file [" << TIMESHEET_FILE_NAME << "]: ";
+    std::getline(std::cin, timesheetName);
+    if (timesheetName == "0") return;
+    if (timesheetName.empty()) timesheetName = TIMESHEET_FILE_NAME;
+
+    std::cout << "Payroll register output [" << REGISTER_FILE_NAME << "]: ";
+    std::getline(std::cin, registerName);
+    if (registerName == "0") return;
+    if (registerName.empty()) registerName = REGISTER_FILE_NAME;
+
+    std::string input;
+    unsigned threads = resolveThreadCount(0);
+    std::cout << "Worker threads [" << threads << "]: ";
+    std::getline(std::cin, input);
+    if (!input.empty()) {
+        try {
+            int requested = std::stoi(input);
+            if (requested > 0) threads = static_cast<unsigned>(requested);
+        } catch (const std::exception&) {
+            std::cout << "Invalid thread count - using " << threads << ".\n";
+        }
+    }
+
+    Timesheet sheet;
+    std::vector<std::string> errors;
+    if (!loadTimesheet(timesheetName, sheet, errors)) {
+        std::cout << "\nTimesheet " << timesheetName << " not found; grade E staff will be paid for 0 days.\n";
+    }
+    for (const auto& error : errors) {
+        std::cout << "Timesheet " << error << "\n";
+    }
+
+    LockGuard writers = store.lockWriters();
+    MappedRoster roster = openRoster();
+    if (roster.liveCount() == 0) {
+        std::cout << "\nNo employee records found!\n";
+        pauseScreen();
+        return;
+    }
+
+    std::vector<PayrollResult> results;
+    size_t recomputed = 0;
+    PayrollTotals totals = runSavedPayroll(store, roster, sheet, false, threads, &results, recomputed, resultsFile);
+
+    if (!writePayrollRegister(registerName, roster, results, totals)) {
+        std::cout << "\nError: could not write " << registerName << ".\n";
+        pauseScreen();
+        return;
+    }
+    std::tm today = currentDate();
+    std::string archiveName = archiveFileName(today.tm_year + 1900, today.tm_mon + 1);
+    if (!writeArchive(archiveName, today.tm_year + 1900, today.tm_mon + 1, roster, sheet, results)) {
+        std::cout << "\nError: could not write " << archiveName << ".\n";
+        pauseScreen();
+        return;
+    }
+
+    std::cout << "\nEmployees paid                  : " << totals.employees << std::endl;
+    std::cout << "Pay recalculated for            : " << recomputed << std::endl;
+    if (totals.missingTimesheets > 0) {
+        std::cout << "Grade E without timesheet entry : " << totals.missingTimesheets << std::endl;
+    }
+    std::cout << "Gross Pay                       : $" << std::setw(14) << totals.gross << std::endl;
+    std::cout << "Total Allowances                : $" << std::setw(14) << totals.allowances << std::endl;
+    std::cout << "Total Deductions                : $" << std::setw(14) << totals.deductions << std::endl;
+    std::cout << "NET PAYROLL                     : $" << std::setw(14) << totals.net << std::endl;
+    std::cout << "\nPayroll register written to " << registerName << std::endl;
+    std::cout << "Run archived to " << archiveName << std::endl;
+
+    pauseScreen();
+}
+
+void PayrollSystem::printSalarySlips() {
+    clearScreen();
+    printHeader("PRINT ALL SALARY SLIPS");
+
+    SlipFilter filter;
+    std::string input;
+    std::cout << "\nGrade (A-E, blank for all, 0 to exit): ";
+    std::getline(std::cin, input);
+    if (input == "0") return;
+    if (!input.empty()) {
+        if (!parseGrade(input, filter.grade)) {
+            std::cout << "\nInvalid grade! Please enter A-E.\n";
+            pauseScreen();
+            return;
+        }
+    }
+
+    std::cout << "Designation (blank for all): ";
+    std::getline(std::cin, filter.designation);
+    std::transform(filter.designation.begin(), filter.designation.end(), filter.designation.begin(), ::toupper);
+
+    std::string timesheetName, slipsName;
+    std::cout << "Grade E timesheet file [" << TIMESHEET_FILE_NAME << "]: ";
+    std::getline(std::cin, timesheetName);
+    if (timesheetName.empty()) timesheetName = TIMESHEET_FILE_NAME;
+
+    std::cout << "Slips output file [" << SLIPS_FILE_NAME << "]: ";
+    std::getline(std::cin, slipsName);
+    if (slipsName.empty()) slipsName = SLIPS_FILE_NAME;
+
+    Timesheet sheet;
+    std::vector<std::string> errors;
+    if (!loadTimesheet(timesheetName, sheet, errors)) {
+        std::cout << "\nTimesheet " << timesheetName << " not found; grade E staff will be paid for 0 days.\n";
+    }
+    for (const auto& error : errors) {
+        std::cout << "Timesheet " << error << "\n";
+    }
+
+    MappedRoster roster = openRoster();
+    PayrollTotals printed;
+    if (!writeSalarySlips(slipsName, roster, sheet, filter, printed)) {
+        std::cout << "\nError: could not write " << slipsName << ".\n";
+        pauseScreen();
+        return;
+    }
+
+    if (printed.employees == 0) {
+        std::cout << "\nNo matching employees found!\n";
     } else {
-        std::cout << "\nDeletion cancelled.\n";
+        std::cout << "\nSlips printed                   : " << printed.employees << std::endl;
+        if (printed.missingTimesheets > 0) {
+            std::cout << "Grade E without timesheet entry : " << printed.missingTimesheets << std::endl;
+        }
+        std::cout << "NET PAY ON SLIPS                : $" << std::setw(14) << printed.net << std::endl;
+        std::cout << "\nSalary slips written to " << slipsName << std::endl;
     }
 
     pauseScreen();
 }
 
-void PayrollSystem::modifyEmployee() {
+void PayrollSystem::importEmployees() {
     clearScreen();
-    printHeader("MODIFY EMPLOYEE");
-    
-    int searchCode;
-    std::cout << "\nEnter Employee Code to modify (0 to exit): ";
-    std::cin >> searchCode;
-    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    printHeader("IMPORT EMPLOYEES");
+
+    std::string fileName;
+    std::cout << "\nCSV file to import (0 to exit): ";
+    std::getline(std::cin, fileName);
+    if (fileName == "0" || fileName.empty()) return;
+
+    std::ofstream errorLog(IMPORT_ERRORS_FILE_NAME, std::ios::trunc);
+    ImportSummary summary;
+    if (!importEmployeesCsv(fileName, store, errorLog, summary)) {
+        std::cout << "\nCould not open " << fileName << ".\n";
+        pauseScreen();
+        return;
+    }
+    errorLog.close();
+
+    std::cout << "\nRows read     : " << summary.rows << std::endl;
+    std::cout << "Imported      : " << summary.imported << std::endl;
+    std::cout << "Rejected      : " << summary.rejected << std::endl;
+    if (summary.rejected > 0) {
+        std::cout << "\nRejected rows are listed in " << IMPORT_ERRORS_FILE_NAME << ".\n";
+    } else {
+        std::remove(IMPORT_ERRORS_FILE_NAME.c_str());
+    }
+    if (summary.writeFailed) {
+        std::cout << "\nError: could not write to " << store.fileName()
+                  << "; rows after the last saved batch were not imported.\n";
+    }
+
+    pauseScreen();
+}
+
+void PayrollSystem::exportEmployees() {
+    clearScreen();
+    printHeader("EXPORT EMPLOYEES");
+
+    std::string fileName;
+    std::cout << "\nExport to [" << EXPORT_FILE_NAME << "]: ";
+    std::getline(std::cin, fileName);
+    if (fileName == "0") return;
+    if (fileName.empty()) fileName = EXPORT_FILE_NAME;
+
+    MappedRoster roster = openRoster();
+    size_t exported = 0;
+    if (exportEmployeesCsv(fileName, roster, exported)) {
+        std::cout << "\n" << exported << " employees exported to " << fileName << ".\n";
+    } else {
+        std::cout << "\nError: could not write " << fileName << ".\n";
+    }
+
+    pauseScreen();
+}
+
+// Timings and I/O counts for everything done since the program started
+void PayrollSystem::showStatistics() {
+    clearScreen();
+    printHeader("STATISTICS");
+    std::cout << "\n";
+    printMetrics(std::cout);
+    pauseScreen();
+}
+
+// Commands that never read the roster, so they neither open the data file
+// nor create its lock file
+bool isStandaloneCommand(const std::string& command) {
+    return command == "bench" || command == "self-test" || command == "--self-test" || command == "stats" ||
+           command == "rules" || command == "help" || command == "--help";
+}
+
+// Commands that calculate pay, and so need the salary rules
+bool paysEmployees(const std::string& command) {
+    return command == "payroll-run" || command == "slip" || command == "slips" || command == "analytics" ||
+           command == "serve";
+}
+
+int PayrollSystem::runCommand(const std::vector<std::string>& args) {
+    if (args.empty()) {
+        printUsage();
+        return 1;
+    }
+
+    const std::string& command = args[0];
+    if (command == "client") return runClient(args);
+    CommandArgs parsed = parseCommandArgs(args, 1);
+    int status = 1;
+    if (isStandaloneCommand(command)) {
+        status = dispatchCommand(command, parsed);
+    } else if (paysEmployees(command) && !gradeRulesReady()) {
+        status = 1;
+    } else if (command == "branch-add") {
+        status = commandBranchAdd(parsed);
+    } else if (!loadBranches()) {
+        status = 1;
+    } else if (manifest) {
+        status = routeCommand(command, parsed);
+    } else {
+        store.open();
+        status = command == "serve" ? serve(parsed) : dispatchCommand(command, parsed);
+    }
+    if (parsed.has("stats")) {
+        printMetrics(std::cerr);
+    }
+    return status;
+}
+
+int PayrollSystem::dispatchCommand(const std::string& command, const CommandArgs& parsed) {
+    if (command == "add") return commandAdd(parsed);
+    if (command == "show") return commandShow(parsed);
+    if (command == "list") return commandList(parsed);
+    if (command == "find") return commandFind(parsed);
+    if (command == "slip") return commandSlip(parsed);
+    if (command == "modify") return commandModify(parsed);
+    if (command == "delete") return commandDelete(parsed);
+    if (command == "payroll-run") return commandPayrollRun(parsed);
+    if (command == "slips") return commandSlips(parsed);
+    if (command == "import") return commandImport(parsed);
+    if (command == "export") return commandExport(parsed);
+    if (command == "analytics") return commandAnalytics(parsed);
+    if (command == "archive-totals") return commandArchiveTotals(parsed);
+    if (command == "archive-ytd") return commandArchiveYtd(parsed);
+    if (command == "compact") {
+        if (!store.compactRecords()) {
+            std::cerr << "Error: could not rewrite " << store.fileName() << ".\n";
+            return 1;
+        }
+        std::cout << "Compacted " << store.fileName() << ".\n";
+        return 0;
+    }
+    if (command == "batch") {
+        if (parsed.positional.empty()) {
+            std::cerr << "batch: missing command file\n";
+            return 1;
+        }
+        return runBatch(parsed.positional[0]);
+    }
+    if (command == "self-test" || command == "--self-test") {
+        size_t mismatches = verifySalaryKernel(100003);
+        std::cout << "Salary kernel self-test: "
+                  << (mismatches == 0 ? "PASSED" : "FAILED") << " (" << mismatches << " mismatches)\n";
+        bool saved = verifySavedResults();
+        std::cout << "Saved results self-test: " << (saved ? "PASSED" : "FAILED") << "\n";
+        return mismatches == 0 && saved ? 0 : 1;
+    }
+    if (command == "bench") return runBenchmarks(parsed);
+    if (command == "stats") {
+        printMetrics(std::cout);
+        return 0;
+    }
+    if (command == "rules") {
+        if (!gradeRulesReady()) return 1;
+        printGradeRules(std::cout);
+        return 0;
+    }
+    if (command == "help" || command == "--help") {
+        printUsage();
+        return 0;
+    }
+
+    std::cerr << "Unknown command: " << command << "\n";
+    printUsage();
+    return 1;
+}
+
+// Runs each non-blank, non-comment line as a command. A failing command is
+// reported and the batch carries on; the exit status is 1 if any failed.
+int PayrollSystem::runBatch(const std::string& fileName) {
+    std::ifstream file;
+    if (fileName != "-") {
+        file.open(fileName);
+        if (!file.is_open()) {
+            std::cerr << "batch: cannot open " << fileName << "\n";
+            return 1;
+        }
+    }
+    std::istream& in = fileName == "-" ? std::cin : file;
+
+    int status = 0;
+    std::string line;
+    int lineNo = 0;
+    while (std::getline(in, line)) {
+        lineNo++;
+        std::vector<std::string> words = tokenizeCommandLine(line);
+        if (words.empty() || words[0][0] == '#') continue;
+        if (words[0] == "batch") {
+            std::cerr << "batch line " << lineNo << ": nested batch files are not supported\n";
+            status = 1;
+            continue;
+        }
+        if (runCommand(words) != 0) {
+            std::cerr << "batch line " << lineNo << ": command failed\n";
+            status = 1;
+        }
+    }
+    return status;
+}
+
+#ifndef _WIN32
+volatile std::sig_atomic_t stopRequested = 0;
+
+void requestStop(int) {
+    stopRequested = 1;
+}
+
+// Longest request line the service accepts; a connection that sends more
+// without a newline is dropped
+const size_t MAX_REQUEST_LINE = 65536;
+
+// A client of the service. Replies wait in output until the socket takes
+// them; no further request is read from a client until its replies have
+// gone, so a client that stops reading only ever holds one reply.
+struct ServiceConnection {
+    int fd;
+    std::string input;
+    std::string output;
+    size_t sent = 0;
+};
+
+bool setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+// Writes as much pending output as the socket takes now; false if the
+// connection has failed
+bool flushOutput(ServiceConnection& connection) {
+    while (connection.sent < connection.output.size()) {
+        ssize_t written = write(connection.fd, connection.output.data() + connection.sent,
+                                connection.output.size() - connection.sent);
+        if (written > 0) {
+            connection.sent += static_cast<size_t>(written);
+        } else if (written < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        }
+    }
+    connection.output.clear();
+    connection.sent = 0;
+    return true;
+}
+#endif
+
+// Runs the service until interrupted. One thread serves every connection in
+// turn from a poll loop, so the store and the cache need no locking of
+// their own; each request takes microseconds against the cache. Sockets are
+// non-blocking, so a slow or stuck client never holds up the others.
+int PayrollSystem::serve(const CommandArgs& args) {
+#ifdef _WIN32
+    (void)args;
+    std::cerr << "serve: the payroll service is not available on this platform\n";
+    return 1;
+#else
+    std::string path = args.get("socket", SOCKET_FILE_NAME);
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "serve: socket path is too long\n";
+        return 1;
+    }
+    // With --metrics the poll wakes at least once an interval to rewrite the file
+    std::string metricsFile = args.get("metrics");
+    int interval = 10;
+    if (args.has("metrics-interval")) {
+        char extra = 0;
+        if (std::sscanf(args.get("metrics-interval").c_str(), "%d%c", &interval, &extra) != 1 || interval < 1) {
+            std::cerr << "serve: --metrics-interval must be 1 or more seconds\n";
+            return 1;
+        }
+    }
+    int existing = connectService(path);
+    if (existing >= 0) {
+        close(existing);
+        std::cerr << "serve: a payroll service is already listening on " << path << "\n";
+        return 1;
+    }
+    unlink(path.c_str());       // Left behind by a service that did not stop cleanly
+
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0 || bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listener, SOMAXCONN) != 0) {
+        std::cerr << "serve: cannot listen on " << path << ": " << std::strerror(errno) << "\n";
+        if (listener >= 0) close(listener);
+        return 1;
+    }
+
+    RosterCache roster;
+    roster.load(store);
+    cache = &roster;
+    store.setChangeListener([&roster](const FileHeader& before, const FileHeader& after,
+                                      const std::vector<JournalSlot>& slots) {
+        roster.apply(before, after, slots);
+    });
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+    std::signal(SIGPIPE, SIG_IGN);
+    auto metricsWritten = std::chrono::steady_clock::now();
+    std::cout << "Serving " << store.fileName() << " (" << roster.liveCount() << " employees) on " << path
+              << "; press Ctrl+C to stop." << std::endl;
+
+    setNonBlocking(listener);
+    std::vector<ServiceConnection> connections;
+    std::vector<pollfd> fds;
+    char buffer[65536];
+
+    // Answers complete request lines while the previous reply has gone out
+    auto serveLines = [this](ServiceConnection& connection) {
+        size_t begin = 0, end;
+        while (connection.output.empty() && (end = connection.input.find('\n', begin)) != std::string::npos) {
+            connection.output = serveRequest(connection.input.substr(begin, end - begin));
+            begin = end + 1;
+            if (!flushOutput(connection)) return false;
+        }
+        connection.input.erase(0, begin);
+        size_t lastLine = connection.input.rfind('\n');
+        size_t partial = lastLine == std::string::npos ? connection.input.size()
+                                                       : connection.input.size() - lastLine - 1;
+        if (partial > MAX_REQUEST_LINE) {
+            std::cerr << "serve: dropped a client whose request exceeded " << MAX_REQUEST_LINE << " bytes\n";
+            return false;
+        }
+        return true;
+    };
+
+    while (!stopRequested) {
+        if (!metricsFile.empty() && secondsSince(metricsWritten) >= interval) {
+            if (!writeMetricsFile(metricsFile)) {
+                std::cerr << "serve: cannot write " << metricsFile << "\n";
+            }
+            metricsWritten = std::chrono::steady_clock::now();
+        }
+        fds.assign(1, {listener, POLLIN, 0});
+        for (const auto& connection : connections) {
+            fds.push_back({connection.fd, static_cast<short>(connection.output.empty() ? POLLIN : POLLOUT), 0});
+        }
+        int timeout = metricsFile.empty() ? -1 : interval * 1000;
+        if (poll(fds.data(), fds.size(), timeout) < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "serve: " << std::strerror(errno) << "\n";
+            break;
+        }
+
+        size_t polled = connections.size();
+        if (fds[0].revents & POLLIN) {
+            int client;
+            while ((client = accept(listener, nullptr, nullptr)) >= 0) {
+                if (setNonBlocking(client)) {
+                    connections.push_back({client, std::string(), std::string()});
+                } else {
+                    close(client);
+                }
+            }
+        }
+        size_t kept = 0;
+        for (size_t i = 0; i < connections.size(); i++) {
+            ServiceConnection& connection = connections[i];
+            short events = i < polled ? fds[i + 1].revents : 0;
+            bool open = !(events & (POLLERR | POLLNVAL));
+            if (open && (events & POLLOUT)) {
+                open = flushOutput(connection);
+            }
+            if (open && (events & (POLLIN | POLLHUP))) {
+                ssize_t got = read(connection.fd, buffer, sizeof(buffer));
+                if (got > 0) {
+                    connection.input.append(buffer, static_cast<size_t>(got));
+                } else if (got == 0 || (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK)) {
+                    open = false;
+                }
+            }
+            if (open && events != 0) {
+                open = serveLines(connection);
+            }
+            if (open) {
+                if (kept != i) connections[kept] = std::move(connection);
+                kept++;
+            } else {
+                close(connection.fd);
+            }
+        }
+        connections.resize(kept);
+    }
+
+    close(listener);
+    for (const auto& connection : connections) {
+        close(connection.fd);
+    }
+    unlink(path.c_str());
+    if (!metricsFile.empty()) {
+        writeMetricsFile(metricsFile);
+    }
+    store.setChangeListener(nullptr);
+    cache = nullptr;
+    std::cout << "Service stopped.\n";
+    return 0;
+#endif
+}
+
+// Runs one request line with the command's output captured for the reply
+std::string PayrollSystem::serveRequest(const std::string& line) {
+    std::vector<std::string> words = tokenizeCommandLine(line);
+    std::stringstream output;
+    std::streambuf* savedOut = std::cout.rdbuf(output.rdbuf());
+    std::streambuf* savedErr = std::cerr.rdbuf(output.rdbuf());
+
+    int status = 1;
+    if (words.empty()) {
+        std::cerr << "Empty request\n";
+    } else if (words[0] == "serve" || words[0] == "client" || words[0] == "batch") {
+        std::cerr << words[0] << ": not available through the service\n";
+    } else if (!cache->refresh(store) && words[0] != "add" && words[0] != "import") {
+        std::cerr << "Error: cannot read " << store.fileName() << ".\n";
+    } else {
+        status = dispatchCommand(words[0], parseCommandArgs(words, 1));
+    }
 
-    if (searchCode == 0) return;
+    std::cout.rdbuf(savedOut);
+    std::cerr.rdbuf(savedErr);
+    std::string body = output.str();
+    return std::to_string(status) + " " + std::to_string(body.size()) + "\n" + body;
+}
 
-    std::vector<Employee> allEmployees = readAllRecords();
-    auto it = std::find_if(allEmployees.begin(), allEmployees.end(), 
-                          [searchCode](const Employee& emp) {
-                              return emp.code == searchCode;
-                          });
+// Creates a branch. The first branch of a directory that already has an
+// EMPLOYEE.DAT takes that roster over, codes and all; later branches start
+// empty in BRANCH-<name>.DAT.
+int PayrollSystem::commandBranchAdd(const CommandArgs& args) {
+    std::string name = args.positional.empty() ? std::string() : args.positional[0];
+    std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+    if (!isValidBranchName(name)) {
+        std::cerr << "branch-add: a branch name is 1-15 letters, digits, '-' or '_'\n";
+        return 1;
+    }
 
-    if (it == allEmployees.end()) {
-        std::cout << "\nEmployee with code " << searchCode << " not found!\n";
-        pauseScreen();
-        return;
+    BranchManifest updated;
+    bool creating = !updated.exists();
+    if (!creating && !updated.load()) {
+        std::cerr << "Error: cannot read " << MANIFEST_FILE_NAME << ".\n";
+        return 1;
+    }
+    if (updated.find(name) >= 0) {
+        std::cerr << "branch-add: there is already a branch " << name << "\n";
+        return 1;
+    }
+    FileHeader header;
+    bool adopt = creating && store.open() && store.readFileHeader(header) && header.last_code > 0;
+    std::string base = adopt ? FILE_NAME.substr(0, FILE_NAME.rfind('.')) : "BRANCH-" + name;
+    if (!updated.addBranch(name, base, adopt ? header.last_code : 0)) {
+        std::cerr << "Error: could not update " << MANIFEST_FILE_NAME << ".\n";
+        return 1;
     }
 
-    Employee& empToModify = *it;
-    std::cout << "\nCurrent employee details:\n";
-    empToModify.display();
+    if (adopt) {
+        std::cout << "Branch " << name << " added with the " << header.record_count - header.deleted_count
+                  << " employee(s) in " << FILE_NAME << ".\n";
+    } else {
+        std::cout << "Branch " << name << " added; its employees are kept in " << base << ".DAT.\n";
+    }
+    // Later commands in a batch route with the new manifest
+    branches.clear();
+    manifest.reset();
+    return 0;
+}
 
-    char choice;
-    std::cout << "\nDo you want to modify this record? (Y/N): ";
-    std::cin >> choice;
-    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-    
-    if (toupper(choice) != 'Y') {
-        return;
+int PayrollSystem::commandBranches(const CommandArgs&) {
+    char line[160];
+    std::snprintf(line, sizeof(line), "%-16s %-24s %10s %12s\n", "BRANCH", "DATA FILE", "EMPLOYEES", "CODES HELD");
+    std::cout << line;
+    for (uint32_t i = 0; i < manifest->size(); i++) {
+        FileHeader header;
+        if (!branch(i).store.readFileHeader(header)) {
+            header = FileHeader{};
+        }
+        std::snprintf(line, sizeof(line), "%-16s %-24s %10u %12llu\n", manifest->name(i).c_str(),
+                      branch(i).store.fileName().c_str(), header.record_count - std::min(header.record_count, header.deleted_count),
+                      static_cast<unsigned long long>(manifest->blocksOwned(i)) * CODE_BLOCK_SIZE);
+        std::cout << line;
     }
+    return 0;
+}
 
-    std::cout << "\nEnter new values (press Enter to keep current value):\n\n";
+int PayrollSystem::commandAdd(const CommandArgs& args) {
+    Employee emp;
+    emp.name = args.get("name");
+    emp.address = args.get("address");
+    emp.phone = args.get("phone");
+    emp.designation = args.get("designation");
+    std::string grade = args.get("grade");
+    emp.grade = grade.size() == 1 ? grade[0] : '\0';
+    std::string house = args.get("house", "N");
+    std::string travel = args.get("travel", "N");
+    emp.house_allowance = house.size() == 1 ? house[0] : '\0';
+    emp.travel_allowance = travel.size() == 1 ? travel[0] : '\0';
 
-    // Modify fields
-    std::string input;
-    
-    std::cout << "Name [" << empToModify.name << "]: ";
-    std::getline(std::cin, input);
-    if (!input.empty()) {
-        std::transform(input.begin(), input.end(), input.begin(), ::toupper);
-        empToModify.name = input;
+    if (!parseDate(args.get("date"), emp.dd, emp.mm, emp.yy)) {
+        std::cerr << "add: --date must be d/m/yyyy\n";
+        return 1;
+    }
+    if (!parseMoney(args.get("salary", "0"), emp.basic_salary) ||
+        !parseMoney(args.get("loan", "0"), emp.loan)) {
+        std::cerr << "add: --salary and --loan must be amounts\n";
+        return 1;
+    }
+    if (const char* error = validateEmployee(emp)) {
+        std::cerr << "add: " << error << "\n";
+        return 1;
     }
 
-    std::cout << "Address [" << empToModify.address << "]: ";
-    std::getline(std::cin, input);
-    if (!input.empty()) {
-        std::transform(input.begin(), input.end(), input.begin(), ::toupper);
-        empToModify.address = input;
+    if (!store.appendRecord(emp)) {
+        std::cerr << "add: could not write to " << store.fileName() << "\n";
+        return 1;
     }
+    std::cout << "Added employee " << emp.code << "\n";
+    return 0;
+}
 
-    std::cout << "Phone [" << empToModify.phone << "]: ";
-    std::getline(std::cin, input);
-    if (!input.empty()) empToModify.phone = input;
+int PayrollSystem::commandShow(const CommandArgs& args) {
+    int code = 0;
+    if (args.positional.empty() || !parseCode(args.positional[0], code)) {
+        std::cerr << "show: expected an employee code\n";
+        return 1;
+    }
+    MappedRoster roster = openRoster();
+    const EmployeeRecord* rec = store.findRecord(roster, code);
+    if (!rec) {
+        std::cerr << "Employee with code " << code << " not found!\n";
+        return 1;
+    }
+    fromRecord(*rec).display();
+    return 0;
+}
 
-    std::cout << "Designation [" << empToModify.designation << "]: ";
-    std::getline(std::cin, input);
-    if (!input.empty()) {
-        std::transform(input.begin(), input.end(), input.begin(), ::toupper);
-        empToModify.designation = input;
+int PayrollSystem::commandList(const CommandArgs& args) {
+    ListOrder order = ORDER_CODE;
+    if (args.has("order") && !parseListOrder(args.get("order"), order)) {
+        std::cerr << "list: --order must be code, name, grade or salary\n";
+        return 1;
+    }
+    long page = 0, pageSize = 20;
+    for (const char* option : {"page", "page-size"}) {
+        if (!args.has(option)) continue;
+        long& value = std::string(option) == "page" ? page : pageSize;
+        char extra = 0;
+        if (std::sscanf(args.get(option).c_str(), "%ld%c", &value, &extra) != 1 || value < 1) {
+            std::cerr << "list: --" << option << " must be 1 or more\n";
+            return 1;
+        }
     }
 
-    std::cout << "Grade [" << empToModify.grade << "] (A/B/C/D/E): ";
-    std::getline(std::cin, input);
-    if (!input.empty() && input.length() == 1) {
-        char newGrade = toupper(input[0]);
-        if (newGrade >= 'A' && newGrade <= 'E') {
-            empToModify.grade = newGrade;
+    MappedRoster roster = openRoster();
+    RosterCursor cursor(roster, manifest ? nullptr : &store, order, args.has("descending"));
+    ScopedTimer timer(METRIC_RENDER);
+    ReportBuffer out(std::cout);
+    displayListHeader(out);
+    uint64_t live = roster.liveCount();
+    if (page > 0) {
+        // A page past the end shows nothing; checking first also keeps
+        // (page - 1) * pageSize from overflowing
+        uint64_t before = static_cast<uint64_t>(page - 1);
+        uint64_t perPage = static_cast<uint64_t>(pageSize);
+        cursor.skip(static_cast<size_t>(before <= live / perPage ? before * perPage : live));
+    }
+    // Without --page every page is shown, one cursor page at a time
+    size_t limit = page > 0 ? static_cast<size_t>(pageSize) : std::numeric_limits<size_t>::max();
+    size_t shown = 0;
+    while (shown < limit) {
+        std::vector<const EmployeeRecord*> rows = cursor.next(std::min(limit - shown, static_cast<size_t>(pageSize)));
+        if (rows.empty()) break;
+        for (const EmployeeRecord* rec : rows) {
+            displayForList(*rec, out);
         }
+        shown += rows.size();
+    }
+    countRecordsScanned(shown);
+    if (cursor.failed()) {
+        out.flush();
+        std::cerr << "Error: could not sort the roster; the listing is incomplete.\n";
+        return 1;
     }
 
-    if (empToModify.grade != 'E') {
-        std::cout << "House Allowance [" << empToModify.house_allowance << "] (Y/N): ";
-        std::getline(std::cin, input);
-        if (!input.empty() && input.length() == 1) {
-            char newHouse = toupper(input[0]);
-            if (newHouse == 'Y' || newHouse == 'N') {
-                empToModify.house_allowance = newHouse;
-            }
+    out.endLine().text("Total employees: ").text(toText(roster.liveCount()));
+    if (page > 0) {
+        uint64_t perPage = static_cast<uint64_t>(pageSize);
+        uint64_t pages = std::max<uint64_t>(1, (live + perPage - 1) / perPage);
+        out.text("  Page ").text(toText(static_cast<int64_t>(page))).text(" of ").text(toText(static_cast<int64_t>(pages)));
+    }
+    out.endLine();
+    return 0;
+}
+
+int PayrollSystem::commandFind(const CommandArgs& args) {
+    EmployeeQuery query;
+    if (args.has("grade")) {
+        if (!parseGrade(args.get("grade"), query.grade)) {
+            std::cerr << "find: --grade must be A-E\n";
+            return 1;
         }
+    }
+    query.designation = args.get("designation");
+    query.namePrefix = args.get("name");
+    std::transform(query.designation.begin(), query.designation.end(), query.designation.begin(), ::toupper);
+    std::transform(query.namePrefix.begin(), query.namePrefix.end(), query.namePrefix.begin(), ::toupper);
+    for (const char* option : {"joined-from", "joined-to"}) {
+        if (!args.has(option)) continue;
+        int d = 0, m = 0, y = 0;
+        if (!parseDate(args.get(option), d, m, y) || !isValidDate(d, m, y)) {
+            std::cerr << "find: --" << option << " must be a valid d/m/yyyy date\n";
+            return 1;
+        }
+        (option[7] == 'f' ? query.joinedFrom : query.joinedTo) = y * 10000 + m * 100 + d;
+    }
 
-        std::cout << "Travel Allowance [" << empToModify.travel_allowance << "] (Y/N): ";
-        std::getline(std::cin, input);
-        if (!input.empty() && input.length() == 1) {
-            char newTravel = toupper(input[0]);
-            if (newTravel == 'Y' || newTravel == 'N') {
-                empToModify.travel_allowance = newTravel;
+    if (manifest) {
+        mergeBranches(&query);
+        ReportBuffer out(std::cout);
+        if (args.has("codes")) {
+            for (const auto& rec : merged) {
+                out.text(toText(rec.code)).endLine();
             }
+            return 0;
+        }
+        displayListHeader(out);
+        for (const auto& rec : merged) {
+            displayForList(rec, out);
         }
+        out.endLine().text("Matching employees: ").text(toText(static_cast<int64_t>(merged.size()))).endLine();
+        return 0;
+    }
 
-        std::cout << "Basic Salary [" << empToModify.basic_salary << "]: $";
-        std::getline(std::cin, input);
-        if (!input.empty()) {
-            try {
-                float newSalary = std::stof(input);
-                if (newSalary >= 0 && newSalary <= 50000) {
-                    empToModify.basic_salary = newSalary;
-                }
-            } catch (const std::exception&) {
-                std::cout << "Invalid salary input - keeping current value.\n";
-            }
+    std::vector<int> codes = store.queryCodes(query);
+    if (args.has("codes")) {
+        ReportBuffer out(std::cout);
+        for (int code : codes) {
+            out.text(toText(code)).endLine();
         }
+        return 0;
     }
 
-    std::cout << "Loan Amount [" << empToModify.loan << "]: $";
-    std::getline(std::cin, input);
-    if (!input.empty()) {
-        try {
-            float newLoan = std::stof(input);
-            if (newLoan >= 0 && newLoan <= 50000) {
-                empToModify.loan = newLoan;
-            }
-        } catch (const std::exception&) {
-            std::cout << "Invalid loan input - keeping current value.\n";
+    MappedRoster roster = openRoster();
+    ScopedTimer timer(METRIC_RENDER);
+    ReportBuffer out(std::cout);
+    displayListHeader(out);
+    for (int code : codes) {
+        if (const EmployeeRecord* rec = store.findRecord(roster, code)) {
+            displayForList(*rec, out);
         }
     }
+    out.endLine().text("Matching employees: ").text(toText(static_cast<int64_t>(codes.size()))).endLine();
+    return 0;
+}
 
-    // Confirm save
-    std::cout << "\nDo you want to save changes? (Y/N): ";
-    std::cin >> choice;
-    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-    
-    if (toupper(choice) == 'Y') {
-        writeAllRecords(allEmployees);
-        std::cout << "\nRecord modified successfully!\n";
-    } else {
-        std::cout << "\nChanges not saved.\n";
+int PayrollSystem::commandSlip(const CommandArgs& args) {
+    int code = 0;
+    if (args.positional.empty() || !parseCode(args.positional[0], code)) {
+        std::cerr << "slip: expected an employee code\n";
+        return 1;
+    }
+    int days = 0, hours = 0;
+    char extra = 0;
+    if (std::sscanf(args.get("days", "0").c_str(), "%d%c", &days, &extra) != 1 || days < 0 || days > 31 ||
+        std::sscanf(args.get("hours", "0").c_str(), "%d%c", &hours, &extra) != 1 || hours < 0) {
+        std::cerr << "slip: --days must be 0-31 and --hours 0 or more\n";
+        return 1;
     }
 
-    pauseScreen();
+    MappedRoster roster = openRoster();
+    const EmployeeRecord* rec = store.findRecord(roster, code);
+    if (!rec) {
+        std::cerr << "Employee with code " << code << " not found!\n";
+        return 1;
+    }
+    const Employee emp = fromRecord(*rec);
+    ReportBuffer out(std::cout);
+    printSlipHeading(out, emp.name, emp.designation, emp.grade, currentDate());
+    printSlipBreakdown(out, emp.grade, calculateSalary(emp, days, hours));
+    return 0;
 }
 
-void PayrollSystem::salarySlip() {
-    clearScreen();
-    printHeader("SALARY SLIP");
-    
-    int searchCode;
-    std::cout << "\nEnter Employee Code (0 to exit): ";
-    std::cin >> searchCode;
-    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+int PayrollSystem::commandModify(const CommandArgs& args) {
+    int code = 0;
+    if (args.positional.empty() || !parseCode(args.positional[0], code)) {
+        std::cerr << "modify: expected an employee code\n";
+        return 1;
+    }
+    Employee emp;
+    long slot = store.findRecord(code, &emp);
+    if (slot < 0) {
+        std::cerr << "Employee with code " << code << " not found!\n";
+        return 1;
+    }
 
-    if (searchCode == 0) return;
+    if (args.has("name")) emp.name = args.get("name");
+    if (args.has("address")) emp.address = args.get("address");
+    if (args.has("phone")) emp.phone = args.get("phone");
+    if (args.has("designation")) emp.designation = args.get("designation");
+    if (args.has("date") && !parseDate(args.get("date"), emp.dd, emp.mm, emp.yy)) {
+        std::cerr << "modify: --date must be d/m/yyyy\n";
+        return 1;
+    }
+    for (const char* flag : {"grade", "house", "travel"}) {
+        if (!args.has(flag)) continue;
+        std::string value = args.get(flag);
+        if (value.size() != 1) {
+            std::cerr << "modify: --" << flag << " takes a single letter\n";
+            return 1;
+        }
+        char& field = flag[0] == 'g' ? emp.grade : flag[0] == 'h' ? emp.house_allowance : emp.travel_allowance;
+        field = value[0];
+    }
+    if ((args.has("salary") && !parseMoney(args.get("salary"), emp.basic_salary)) ||
+        (args.has("loan") && !parseMoney(args.get("loan"), emp.loan))) {
+        std::cerr << "modify: --salary and --loan must be amounts\n";
+        return 1;
+    }
+    if (const char* error = validateEmployee(emp)) {
+        std::cerr << "modify: " << error << "\n";
+        return 1;
+    }
 
-    std::vector<Employee> allEmployees = readAllRecords();
-    auto it = std::find_if(allEmployees.begin(), allEmployees.end(), 
-                          [searchCode](const Employee& emp) {
-                              return emp.code == searchCode;
-                          });
+    if (store.updateRecord(static_cast<uint32_t>(slot), emp) != EmployeeStore::UPDATE_DONE) {
+        std::cerr << "modify: could not update " << store.fileName() << "\n";
+        return 1;
+    }
+    std::cout << "Modified employee " << code << "\n";
+    return 0;
+}
 
-    if (it == allEmployees.end()) {
-        std::cout << "\nEmployee with code " << searchCode << " not found!\n";
-        pauseScreen();
-        return;
+int PayrollSystem::commandDelete(const CommandArgs& args) {
+    int code = 0;
+    if (args.positional.empty() || !parseCode(args.positional[0], code)) {
+        std::cerr << "delete: expected an employee code\n";
+        return 1;
     }
+    long slot = store.findRecord(code);
+    if (slot < 0) {
+        std::cerr << "Employee with code " << code << " not found!\n";
+        return 1;
+    }
+    if (!store.deleteRecord(static_cast<uint32_t>(slot), code)) {
+        std::cerr << "delete: could not update " << store.fileName() << "\n";
+        return 1;
+    }
+    if (store.needsCompaction()) {
+        store.compactRecords();
+    }
+    std::cout << "Deleted employee " << code << "\n";
+    return 0;
+}
 
-    const Employee& emp = *it;
-    clearScreen();
+int PayrollSystem::commandPayrollRun(const CommandArgs& args) {
+    std::string timesheetName = args.get("timesheet", TIMESHEET_FILE_NAME);
+    std::string registerName = args.get("output", REGISTER_FILE_NAME);
+    int threads = 0;
+    if (args.has("threads")) {
+        char extra = 0;
+        if (std::sscanf(args.get("threads").c_str(), "%d%c", &threads, &extra) != 1 || threads < 1) {
+            std::cerr << "payroll-run: --threads must be 1 or more\n";
+            return 1;
+        }
+    }
+    std::tm today = currentDate();
+    int year = today.tm_year + 1900, month = today.tm_mon + 1;
+    if (args.has("month") && !parseMonth(args.get("month"), year, month)) {
+        std::cerr << "payroll-run: --month must be yyyy-mm\n";
+        return 1;
+    }
 
-    // Get current date
-    time_t rawtime;
-    struct tm* timeinfo;
-    time(&rawtime);
-    timeinfo = localtime(&rawtime);
-    
-    std::string months[] = {"January", "February", "March", "April", "May", "June",
-                           "July", "August", "September", "October", "November", "December"};
+    Timesheet sheet;
+    std::vector<std::string> errors;
+    if (!loadTimesheet(timesheetName, sheet, errors) && args.has("timesheet")) {
+        std::cerr << "payroll-run: cannot open " << timesheetName << "\n";
+        return 1;
+    }
+    for (const auto& error : errors) {
+        std::cerr << "Timesheet " << error << "\n";
+    }
 
-    // Print salary slip
-    std::cout << std::string(80, '=') << std::endl;
-    std::cout << std::setw(45) << "SALARY SLIP" << std::endl;
-    std::cout << std::setw(35) << months[timeinfo->tm_mon] << ", " << (timeinfo->tm_year + 1900) << std::endl;
-    std::cout << std::string(80, '=') << std::endl;
+    bool writeRegister = !args.has("no-register");
+    std::vector<PayrollResult> results;
+    size_t recomputed = 0;
+    auto report = [&](const MappedRoster& roster, const PayrollTotals& totals) {
+        if (writeRegister && !writePayrollRegister(registerName, roster, results, totals)) {
+            std::cerr << "payroll-run: could not write " << registerName << "\n";
+            return 1;
+        }
+        std::string archiveName = archiveFileName(year, month);
+        if (writeRegister && !writeArchive(archiveName, year, month, roster, sheet, results)) {
+            std::cerr << "payroll-run: could not write " << archiveName << "\n";
+            return 1;
+        }
 
-    std::cout << "\nEmployee Name: " << emp.name;
-    std::cout << std::setw(40) << "Date: " << timeinfo->tm_mday << "/" 
-              << (timeinfo->tm_mon + 1) << "/" << (timeinfo->tm_year + 1900) << std::endl;
-    std::cout << "Designation  : " << emp.designation;
-    std::cout << std::setw(40) << "Grade: " << emp.grade << std::endl;
+        std::cout << "Employees paid: " << totals.employees
+                  << "  Recalculated: " << recomputed
+                  << "  Gross: " << totals.gross
+                  << "  Allowances: " << totals.allowances
+                  << "  Deductions: " << totals.deductions
+                  << "  Net: " << totals.net << "\n";
+        if (totals.missingTimesheets > 0) {
+            std::cout << "Grade E without timesheet entry: " << totals.missingTimesheets << "\n";
+        }
+        if (writeRegister) {
+            std::cout << "Payroll register written to " << registerName << "\n";
+            std::cout << "Run archived to " << archiveName << "\n";
+        }
+        return 0;
+    };
 
-    std::cout << std::string(80, '-') << std::endl;
+    if (manifest) {
+        PayrollTotals totals = payBranches(sheet, args.has("full"), static_cast<unsigned>(threads),
+                                           writeRegister ? &results : nullptr, recomputed);
+        return report(MappedRoster(merged.data(), static_cast<uint32_t>(merged.size()), FileHeader{}), totals);
+    }
+    LockGuard writers = store.lockWriters();
+    MappedRoster roster = openRoster();
+    PayrollTotals totals = runSavedPayroll(store, roster, sheet, args.has("full"), static_cast<unsigned>(threads),
+                                           writeRegister ? &results : nullptr, recomputed, resultsFile);
+    return report(roster, totals);
+}
 
-    double hra = 0.0, ca = 0.0, da = 0.0, pf = 0.0, ld = 0.0, ot = 0.0;
-    double basic = emp.basic_salary;
+int PayrollSystem::commandSlips(const CommandArgs& args) {
+    SlipFilter filter;
+    if (args.has("grade")) {
+        if (!parseGrade(args.get("grade"), filter.grade)) {
+            std::cerr << "slips: --grade must be A-E\n";
+            return 1;
+        }
+    }
+    filter.designation = args.get("designation");
+    std::transform(filter.designation.begin(), filter.designation.end(), filter.designation.begin(), ::toupper);
 
-    if (emp.grade == 'E') {
-        int days, hours;
-        
-        do {
-            std::cout << "\nDays worked this month (0-31): ";
-            std::cin >> days;
-            if (std::cin.fail() || days < 0 || days > 31) {
-                std::cin.clear();
-                std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-                std::cout << "Invalid input! Please enter 0-31.\n";
-            } else {
-                break;
-            }
-        } while (true);
+    std::string timesheetName = args.get("timesheet", TIMESHEET_FILE_NAME);
+    std::string slipsName = args.get("output", SLIPS_FILE_NAME);
+    int threads = 0;
+    if (args.has("threads")) {
+        char extra = 0;
+        if (std::sscanf(args.get("threads").c_str(), "%d%c", &threads, &extra) != 1 || threads < 1) {
+            std::cerr << "slips: --threads must be 1 or more\n";
+            return 1;
+        }
+    }
 
-        do {
-            std::cout << "Overtime hours (0 or more): ";
-            std::cin >> hours;
-            if (std::cin.fail() || hours < 0) {
-                std::cin.clear();
-                std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-                std::cout << "Invalid input! Please enter 0 or more.\n";
-            } else {
-                break;
-            }
-        } while (true);
+    Timesheet sheet;
+    std::vector<std::string> errors;
+    if (!loadTimesheet(timesheetName, sheet, errors) && args.has("timesheet")) {
+        std::cerr << "slips: cannot open " << timesheetName << "\n";
+        return 1;
+    }
+    for (const auto& error : errors) {
+        std::cerr << "Timesheet " << error << "\n";
+    }
 
-        basic = days * 30.0;
-        ot = hours * 10.0;
-        ld = (15.0 * emp.loan) / 100.0;
+    MappedRoster roster = openRoster();
+    PayrollTotals printed;
+    if (!writeSalarySlips(slipsName, roster, sheet, filter, printed, static_cast<unsigned>(threads))) {
+        std::cerr << "slips: could not write " << slipsName << "\n";
+        return 1;
+    }
 
-    } else {
-        if (emp.house_allowance == 'Y') hra = (5.0 * emp.basic_salary) / 100.0;
-        if (emp.travel_allowance == 'Y') ca = (2.0 * emp.basic_salary) / 100.0;
-        da = (5.0 * emp.basic_salary) / 100.0;
-        pf = (2.0 * emp.basic_salary) / 100.0;
-        ld = (15.0 * emp.loan) / 100.0;
-        basic = emp.basic_salary;
+    std::cout << "Slips printed: " << printed.employees << "  Net: " << printed.net << "\n";
+    if (printed.missingTimesheets > 0) {
+        std::cout << "Grade E without timesheet entry: " << printed.missingTimesheets << "\n";
+    }
+    std::cout << "Salary slips written to " << slipsName << "\n";
+    return 0;
+}
+
+int PayrollSystem::commandAnalytics(const CommandArgs& args) {
+    std::string by = args.get("by");
+    std::string column = args.get("column", "net");
+    int amount = analyticsAmount(column);
+    if (amount < 0) {
+        std::cerr << "analytics: unknown --column " << column << "\n";
+        return 1;
+    }
+    int grouping = -1;
+    for (int i = 0; i < GROUPING_COUNT; i++) {
+        if (by == GROUPING_NAMES[i]) grouping = i;
+    }
+    if (!by.empty() && grouping < 0) {
+        std::cerr << "analytics: --by must be grade, designation or year\n";
+        return 1;
+    }
+    int threads = 0;
+    if (args.has("threads")) {
+        char extra = 0;
+        if (std::sscanf(args.get("threads").c_str(), "%d%c", &threads, &extra) != 1 || threads < 1) {
+            std::cerr << "analytics: --threads must be 1 or more\n";
+            return 1;
+        }
+    }
+
+    std::string timesheetName = args.get("timesheet", TIMESHEET_FILE_NAME);
+    Timesheet sheet;
+    std::vector<std::string> errors;
+    if (!loadTimesheet(timesheetName, sheet, errors) && args.has("timesheet")) {
+        std::cerr << "analytics: cannot open " << timesheetName << "\n";
+        return 1;
+    }
+    for (const auto& error : errors) {
+        std::cerr << "Timesheet " << error << "\n";
     }
 
-    double allowance = hra + ca + da + ot;
-    double deduction = pf + ld;
-    double netSalary = (basic + allowance) - deduction;
+    MappedRoster roster = openRoster();
+    RosterAnalytics analytics = analyseRoster(roster, sheet, static_cast<unsigned>(threads));
+    if (args.has("csv") && !writeAnalyticsCsv(args.get("csv"), analytics)) {
+        std::cerr << "analytics: could not write " << args.get("csv") << "\n";
+        return 1;
+    }
 
-    // Display salary breakdown
-    std::cout << std::fixed << std::setprecision(2);
-    std::cout << "\nSALARY BREAKDOWN:\n";
-    std::cout << std::string(80, '-') << std::endl;
-    
-    std::cout << "Basic Salary                    : $" << std::setw(10) << basic << std::endl;
-    
-    std::cout << "\nALLOWANCES:\n";
-    if (emp.grade != 'E') {
-        std::cout << "  House Allowance (5%)          : $" << std::setw(10) << hra << std::endl;
-        std::cout << "  Travel Allowance (2%)         : $" << std::setw(10) << ca << std::endl;
-        std::cout << "  Dearness Allowance (5%)       : $" << std::setw(10) << da << std::endl;
+    ScopedTimer timer(METRIC_RENDER);
+    ReportBuffer out(std::cout);
+    std::string columnHeading = column;
+    std::transform(columnHeading.begin(), columnHeading.end(), columnHeading.begin(), ::toupper);
+    out.text("Amount: ").text(columnHeading).endLine();
+    for (int i = 0; i < GROUPING_COUNT; i++) {
+        if (grouping >= 0 && i != grouping) continue;
+        out.endLine();
+        printAnalytics(out, analytics, static_cast<Grouping>(i), amount);
+    }
+    if (analytics.missingTimesheets > 0) {
+        out.endLine().text("Grade E without timesheet entry: ").text(toText(analytics.missingTimesheets)).endLine();
+    }
+    if (args.has("csv")) {
+        out.text("Analytics written to ").text(args.get("csv")).endLine();
+    }
+    return 0;
+}
+
+// Months named by --month yyyy-mm or --year yyyy; by default the current
+// year up to the current month
+bool archiveMonths(const CommandArgs& args, const char* command, std::vector<std::pair<int, int>>& months) {
+    int year = 0, month = 0;
+    if (args.has("month")) {
+        if (!parseMonth(args.get("month"), year, month)) {
+            std::cerr << command << ": --month must be yyyy-mm\n";
+            return false;
+        }
+        months.push_back({year, month});
+        return true;
+    }
+    std::tm today = currentDate();
+    int last = 12;
+    year = today.tm_year + 1900;
+    if (args.has("year")) {
+        char extra = 0;
+        if (std::sscanf(args.get("year").c_str(), "%d%c", &year, &extra) != 1 || year < 1900 || year > 9999) {
+            std::cerr << command << ": --year must be yyyy\n";
+            return false;
+        }
     } else {
-        std::cout << "  Overtime                      : $" << std::setw(10) << ot << std::endl;
+        last = today.tm_mon + 1;
     }
-    std::cout << "  Total Allowances              : $" << std::setw(10) << allowance << std::endl;
+    for (month = 1; month <= last; month++) {
+        months.push_back({year, month});
+    }
+    return true;
+}
+
+FormattedText archiveValueText(const std::string& column, int64_t value) {
+    return column == "days" || column == "hours" ? toText(value) : toText(Money(value));
+}
 
-    std::cout << "\nDEDUCTIONS:\n";
-    if (emp.grade != 'E') {
-        std::cout << "  Provident Fund (2%)           : $" << std::setw(10) << pf << std::endl;
+int PayrollSystem::commandArchiveTotals(const CommandArgs& args) {
+    std::string column = args.get("column", "net");
+    std::string by = args.get("by");
+    if (!isArchiveColumn(column)) {
+        std::cerr << "archive-totals: unknown --column " << column << "\n";
+        return 1;
+    }
+    if (!by.empty() && by != "grade" && by != "designation") {
+        std::cerr << "archive-totals: --by must be grade or designation\n";
+        return 1;
+    }
+    std::vector<std::pair<int, int>> months;
+    if (!archiveMonths(args, "archive-totals", months)) {
+        return 1;
     }
-    std::cout << "  Loan Deduction (15%)          : $" << std::setw(10) << ld << std::endl;
-    std::cout << "  Total Deductions              : $" << std::setw(10) << deduction << std::endl;
 
-    std::cout << std::string(80, '=') << std::endl;
-    std::cout << "NET SALARY                      : $" << std::setw(10) << netSalary << std::endl;
-    std::cout << std::string(80, '=') << std::endl;
+    struct GroupTotal {
+        int64_t slips = 0;
+        int64_t sum = 0;
+    };
+    std::map<std::string, GroupTotal> groups;
+    int read = 0;
+    std::vector<int64_t> values, indexes;
+    std::vector<std::string> dictionary;
+    for (const auto& ym : months) {
+        ArchiveReader archive;
+        if (!archive.open(archiveFileName(ym.first, ym.second))) continue;
+        if (!archive.readValues(column.c_str(), values) ||
+            (!by.empty() && !archive.readText(by.c_str(), indexes, dictionary))) {
+            std::cerr << "archive-totals: " << archiveFileName(ym.first, ym.second) << " is damaged\n";
+            return 1;
+        }
+        if (by.empty()) {
+            dictionary.assign(1, "ALL");
+            indexes.assign(values.size(), 0);
+        }
+        // Sum by dictionary index first, then merge by name
+        std::vector<GroupTotal> sums(dictionary.size());
+        for (size_t row = 0; row < values.size(); row++) {
+            sums[static_cast<size_t>(indexes[row])].slips++;
+            sums[static_cast<size_t>(indexes[row])].sum += values[row];
+        }
+        for (size_t i = 0; i < sums.size(); i++) {
+            groups[dictionary[i]].slips += sums[i].slips;
+            groups[dictionary[i]].sum += sums[i].sum;
+        }
+        read++;
+    }
+    if (read == 0) {
+        std::cerr << "archive-totals: no archived payroll runs for the requested months\n";
+        return 1;
+    }
 
-    std::cout << "\n\nCASHIER" << std::setw(65) << "EMPLOYEE" << std::endl;
-    
-    pauseScreen();
+    ReportBuffer out(std::cout);
+    std::string heading = by.empty() ? std::string("ALL") : by;
+    std::string columnHeading = column;
+    std::transform(heading.begin(), heading.end(), heading.begin(), ::toupper);
+    std::transform(columnHeading.begin(), columnHeading.end(), columnHeading.begin(), ::toupper);
+    out.left(heading, 22).right("SLIPS", 12).right(columnHeading, 18).endLine();
+    out.ch('-', 52).endLine();
+    GroupTotal total;
+    for (const auto& group : groups) {
+        out.left(group.first, 22).right(toText(group.second.slips), 12)
+           .right(archiveValueText(column, group.second.sum), 18).endLine();
+        total.slips += group.second.slips;
+        total.sum += group.second.sum;
+    }
+    out.ch('-', 52).endLine();
+    out.left("TOTAL", 22).right(toText(total.slips), 12).right(archiveValueText(column, total.sum), 18).endLine();
+    out.text("Months archived: ").text(toText(read)).endLine();
+    return 0;
+}
+
+int PayrollSystem::commandArchiveYtd(const CommandArgs& args) {
+    int code = 0;
+    if (args.positional.empty() || !parseCode(args.positional[0], code)) {
+        std::cerr << "archive-ytd: expected an employee code\n";
+        return 1;
+    }
+    std::vector<std::pair<int, int>> months;
+    if (!archiveMonths(args, "archive-ytd", months)) {
+        return 1;
+    }
+
+    ReportBuffer out(std::cout);
+    out.left("MONTH", 10).right("GROSS", 16).right("DEDUCTIONS", 16).right("NET", 16).endLine();
+    out.ch('-', 58).endLine();
+    Money gross, deductions, net;
+    std::vector<int64_t> codes, basic, allowances, deducted, paid;
+    int found = 0;
+    for (const auto& ym : months) {
+        ArchiveReader archive;
+        if (!archive.open(archiveFileName(ym.first, ym.second)) || !archive.readValues("code", codes)) continue;
+        auto it = std::find(codes.begin(), codes.end(), code);
+        if (it == codes.end()) continue;
+        size_t row = static_cast<size_t>(it - codes.begin());
+        if (!archive.readValues("basic", basic) || !archive.readValues("allowances", allowances) ||
+            !archive.readValues("deductions", deducted) || !archive.readValues("net", paid)) {
+            std::cerr << "archive-ytd: " << archiveFileName(ym.first, ym.second) << " is damaged\n";
+            return 1;
+        }
+        Money monthGross(basic[row] + allowances[row]);
+        char label[16];
+        std::snprintf(label, sizeof(label), "%04d-%02d", ym.first, ym.second);
+        out.left(label, 10).right(toText(monthGross), 16).right(toText(Money(deducted[row])), 16)
+           .right(toText(Money(paid[row])), 16).endLine();
+        gross += monthGross;
+        deductions += Money(deducted[row]);
+        net += Money(paid[row]);
+        found++;
+    }
+    out.ch('-', 58).endLine();
+    out.left("TOTAL", 10).right(toText(gross), 16).right(toText(deductions), 16).right(toText(net), 16).endLine();
+    if (found == 0) {
+        out.flush();
+        std::cerr << "No archived pay for employee " << code << " in the requested months.\n";
+        return 1;
+    }
+    return 0;
+}
+
+int PayrollSystem::commandImport(const CommandArgs& args) {
+    if (args.positional.empty()) {
+        std::cerr << "import: missing CSV file\n";
+        return 1;
+    }
+    ImportSummary summary;
+    if (!importEmployeesCsv(args.positional[0], store, std::cerr, summary)) {
+        std::cerr << "import: cannot open " << args.positional[0] << "\n";
+        return 1;
+    }
+    std::cout << "Rows read: " << summary.rows << "  Imported: " << summary.imported
+              << "  Rejected: " << summary.rejected << "\n";
+    if (summary.writeFailed) {
+        std::cerr << "import: could not write to " << store.fileName() << "\n";
+        return 1;
+    }
+    return summary.rejected == 0 ? 0 : 2;
+}
+
+int PayrollSystem::commandExport(const CommandArgs& args) {
+    std::string fileName = args.positional.empty() ? EXPORT_FILE_NAME : args.positional[0];
+    MappedRoster roster = openRoster();
+    size_t exported = 0;
+    if (!exportEmployeesCsv(fileName, roster, exported)) {
+        std::cerr << "export: could not write " << fileName << "\n";
+        return 1;
+    }
+    std::cout << exported << " employees exported to " << fileName << "\n";
+    return 0;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        PayrollSystem payroll;
+        return payroll.runCommand(std::vector<std::string>(argv + 1, argv + argc));
+    }
+    if (!gradeRulesReady()) {
+        return 1;
+    }
+
     std::cout << "Welcome to Payroll Management System\n";
     std::cout << "====================================\n\n";
     